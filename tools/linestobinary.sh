@@ -0,0 +1,80 @@
+#!/bin/bash
+
+# linestobinary.sh
+
+########################################################################
+# MIT License
+#
+# Copyright (c) 2020-2022 Zartaj Majeed
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+########################################################################
+
+function usage {
+  echo "usage: linestobinary.sh [-e endian] < in.txt > out.dat"
+  echo "converts lines of text on stdin to length-prefixed strings as binary data on stdout"
+  echo "output is 64-bit number of lines followed by 64-bit length and bytes of each line without its newline"
+  echo "-e: endian format big|little, default is little"
+  echo "examples:"
+  echo
+  echo "printf 'ab\nc\n' | linestobinary.sh | od -An -tx1 -w8 -v"
+}
+
+while getopts "e:h" opt; do
+  case $opt in
+    e) endian=$OPTARG;;
+    h) usage; exit 0;;
+    *) usage; exit 1
+  esac
+done
+shift $((OPTIND-1))
+
+: ${endian:=little}
+
+[[ $endian != big && $endian != little ]] && usage && exit 1
+
+# lengths are counted in bytes not characters
+export LC_ALL=C
+
+# prints 64-bit number as binary data
+function word {
+  local hex str
+  printf -vhex "%.16x" $1
+
+  if [[ $endian == little ]]; then
+    for((j=14; j >= 0; j-=2)); do
+      str+="\\x${hex:j:2}"
+    done
+  else
+    for((j=0; j < 16; j+=2)); do
+      str+="\\x${hex:j:2}"
+    done
+  fi
+
+  printf "$str"
+}
+
+mapfile -t lines
+
+word ${#lines[*]}
+
+for line in "${lines[@]}"; do
+  word ${#line}
+  printf "%s" "$line"
+done
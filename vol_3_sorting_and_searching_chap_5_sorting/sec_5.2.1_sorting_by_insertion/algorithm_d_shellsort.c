@@ -9,10 +9,52 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <time.h>
+#include <threads.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SHELLSORT_SIMD_X86
+#endif
+
+// the increments can follow the data in the input as before, or come from a named sequence or a saved table
+// named sequences h_0 = 1 < h_1 < h_2 < ... are generated up to the size of the input
+// knuth: h_(s+1) = 3h_s + 1, 1, 4, 13, 40, 121, ..., stopping with h_(t-1) when h_(t+1) >= N, 5.2.1 (8)
+// sedgewick: 9 * 4^k - 9 * 2^k + 1 and 4^k - 3 * 2^k + 1 merged, 1, 5, 19, 41, 109, 209, 505, ..., Sedgewick 1986
+// tokuda: h_s = ceiling(h'_s) with h'_0 = 1 and h'_(s+1) = 2.25 * h'_s + 1, 1, 4, 9, 20, 46, 103, ..., Tokuda 1992
+// ciura: 1, 4, 10, 23, 57, 132, 301, 701 found by experiment by Ciura 2001, extended by h_(s+1) = floor(2.25 * h_s)
+// all sequences but knuth use every increment less than N
+
+// -a times every named sequence on random keys for the given N on this machine
+// and saves the increments of the fastest as a table for -f in later runs
+// the table is the same uint64_t t, uint64_t[t] increments that can follow the data in the input
+
+// for increment h, D2 through D6 insert each K_j into the chain K_r, K_(r+h), K_(r+2h), ... with r = (j - 1) mod h + 1
+// the h chains share no keys, so any order that takes the keys of each chain in increasing j gives the same result
+// -t splits the chains of each h into T groups of neighboring chains, one for each thread, when h is at least THREAD_H
+// keys are still taken a row of h at a time, so each thread walks through memory in order like D2
+// -v inserts neighboring keys K_j,...,K_(j+W-1) at once, one in each SIMD lane, W = 8 with AVX-512 and W = 4 with AVX2
+// they lie in W different chains when h >= W, every lane compares with the key h back in its own chain
+// lanes that find their place stop and lanes still moving shift their keys up by h with a masked store
+// h < W, and the keys of a row that do not fill a vector, are inserted by the scalar loop of D3 through D6
+
+// smallest increment whose chains are split over threads, smaller h has too little work for each thread
+#define THREAD_H 256
+
+// most threads for -t, the arrays of threads are on the stack
+#define THREADS_MAX 1024
+
+// most increments in a sequence, enough for any 64-bit N
+#define INCREMENTS_MAX 128
+
+// default name of table file saved by -a
+#define TABLE_FILE "algorithm_d_shellsort.table.dat"
 
 static void usage()
 {
-  puts("usage:algorithm_d_shellsort <in.dat >out.dat");
+  puts("usage:algorithm_d_shellsort [-s knuth | sedgewick | tokuda | ciura | -f table.dat] [-t threads] [-v] <in.dat >out.dat");
+  puts("usage:algorithm_d_shellsort -a N [-f table.dat] [-t threads] [-v]");
 
   puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
 
@@ -34,9 +76,101 @@ static void usage()
   puts("uint64_t N");
   puts("int64_t[N] sorted data");
 
+  puts("");
+  puts("-s: increments of the named sequence, input is only N and data");
+  puts("-f: increments of the table file saved by -a, input is only N and data");
+  puts("-a: time each named sequence on N random keys and save the increments of the fastest to the -f file, default is " TABLE_FILE);
+  puts("-t: chains of each increment h >= 256 are split over this many threads, 1 to 1024");
+  puts("-v: keys of neighboring chains are inserted together with SIMD vectors, AVX-512 or AVX2 chosen at run time, scalar if neither is available");
+
   puts("");
   puts("examples:");
   puts("algorithm_d_shellsort <data/algorithm_d_shellsort/in.0.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_d_shellsort -s ciura <data/algorithm_d_shellsort/in.2.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_d_shellsort -a 1000000 -f /tmp/table.dat && algorithm_d_shellsort -f /tmp/table.dat <in.dat >out.dat");
+  puts("algorithm_d_shellsort -s ciura -t 4 -v <data/algorithm_d_shellsort/in.3.le.dat | od -An -td8 -w8 -v");
+}
+
+// names of built-in sequences
+static const char* const SEQUENCES[] = {"knuth", "sedgewick", "tokuda", "ciura"};
+
+#define SEQUENCE_COUNT (sizeof SEQUENCES / sizeof *SEQUENCES)
+
+// keeps h_0,...,h_(t-1) of all increments less than N, keeps h_0 = 1 in any case
+static uint64_t below(const uint64_t N, const uint64_t t, const uint64_t H[t])
+{
+  uint64_t s = 1;
+  while(s < t && H[s] < N) {
+    ++s;
+  }
+  return s;
+}
+
+// fills H with increments of sequence number q for N keys
+// returns number of increments t
+static uint64_t increments(const uint64_t q, const uint64_t N, uint64_t H[INCREMENTS_MAX])
+{
+
+// generate while increments fit in 63 bits, then cut at N
+  const uint64_t LIMIT = UINT64_C(1) << 62;
+  uint64_t t = 0;
+
+  switch(q) {
+
+    case 0:
+// h_(s+1) = 3h_s + 1, stop with h_(t-1) when h_(t+1) >= N
+      for(uint64_t h = 1; h < LIMIT; h = 3 * h + 1) {
+        H[t++] = h;
+      }
+      {
+        uint64_t s = 0;
+        while(s + 2 < t && H[s + 2] < N) {
+          ++s;
+        }
+        return s + 1;
+      }
+
+    case 1:
+// 9 * 4^k - 9 * 2^k + 1 for even s and 4^(k+2) - 3 * 2^(k+2) + 1 for odd s, k = floor(s / 2)
+      for(uint64_t k = 0, p2 = 1; 16 * p2 * p2 < LIMIT; ++k, p2 *= 2) {
+        H[t++] = 9 * p2 * p2 - 9 * p2 + 1;
+        H[t++] = 16 * p2 * p2 - 12 * p2 + 1;
+      }
+      break;
+
+    case 2:
+// h'_(s+1) = 2.25 * h'_s + 1, h_s = ceiling(h'_s)
+      for(double h = 1; h < LIMIT; h = 2.25 * h + 1) {
+        const uint64_t whole = h;
+        H[t++] = whole + (h > whole);
+      }
+      break;
+
+    case 3:
+// Ciura's increments, then h_(s+1) = floor(2.25 * h_s)
+      {
+        static const uint64_t CIURA[] = {1, 4, 10, 23, 57, 132, 301, 701};
+        for(; t < sizeof CIURA / sizeof *CIURA; ++t) {
+          H[t] = CIURA[t];
+        }
+        for(uint64_t h = H[t - 1] * 9 / 4; h < LIMIT / 4; h = h * 9 / 4) {
+          H[t++] = h;
+        }
+      }
+      break;
+  }
+
+  return below(N, t, H);
+}
+
+// number of built-in sequence with name, SEQUENCE_COUNT if there is none
+static uint64_t sequence(const char* name)
+{
+  uint64_t q = 0;
+  while(q < SEQUENCE_COUNT && strcmp(name, SEQUENCES[q]) != 0) {
+    ++q;
+  }
+  return q;
 }
 
 
@@ -88,12 +222,359 @@ void Sort(const uint64_t N, int64_t K_[N], const uint64_t t, uint64_t H[t])
 
 }
 
+// D3 through D6 for one key K_j with increment h
+static inline void insert(int64_t K_[], const uint64_t j, const uint64_t h)
+{
+
+// D3 [Set up i, K, R] i <- j - h, K <- K_j
+  const int64_t K = K_[j];
+  int64_t i = j - h;
+
+// D4 [Compare K:K_i] To D6 if K >= K_i
+  for(; i > 0 && K < K_[i]; i -= h) {
+// D5 [Move R_i, decrease i] R_{i+h} <- R_i, i <- i - h, to D4 if i > 0
+    K_[i + h] = K_[i];
+  }
+
+// D6 [R into R_{i+h}] R_{i+h} <- R
+  K_[i + h] = K;
+}
+
+#ifdef SHELLSORT_SIMD_X86
+
+// D3 through D6 for keys K_j,...,K_(j+7) of 8 different chains, h >= 8
+__attribute__((target("avx512f")))
+static inline void insert8(int64_t K_[], const uint64_t j, const uint64_t h)
+{
+
+  const __m512i K = _mm512_loadu_si512((const void*)&K_[j]);
+  int64_t i = j - h;
+
+// lanes whose key has not found its place
+  __mmask8 active = 0xff;
+
+  while(active != 0 && i > 0) {
+    const __m512i Ki = _mm512_loadu_si512((const void*)&K_[i]);
+// D4 lanes with K < K_i move K_i up, the others put K in R_{i+h}
+    const __mmask8 move = _mm512_mask_cmplt_epi64_mask(active, K, Ki);
+    _mm512_mask_storeu_epi64(&K_[i + h], active, _mm512_mask_blend_epi64(move, K, Ki));
+    active = move;
+    i -= h;
+  }
+
+// D6 lanes that reached the start of their chain
+  _mm512_mask_storeu_epi64(&K_[i + h], active, K);
+}
+
+// D3 through D6 for keys K_j,...,K_(j+3) of 4 different chains, h >= 4
+__attribute__((target("avx2")))
+static inline void insert4(int64_t K_[], const uint64_t j, const uint64_t h)
+{
+
+  const __m256i K = _mm256_loadu_si256((const void*)&K_[j]);
+  int64_t i = j - h;
+
+// lanes whose key has not found its place are all ones
+  __m256i active = _mm256_set1_epi64x(-1);
+
+  while(i > 0) {
+    const __m256i Ki = _mm256_loadu_si256((const void*)&K_[i]);
+// D4 lanes with K < K_i move K_i up, the others put K in R_{i+h}
+    const __m256i move = _mm256_and_si256(active, _mm256_cmpgt_epi64(Ki, K));
+    _mm256_maskstore_epi64((long long*)&K_[i + h], active, _mm256_blendv_epi8(K, Ki, move));
+    active = move;
+    i -= h;
+    if(_mm256_testz_si256(active, active))
+      return;
+  }
+
+// D6 lanes that reached the start of their chain
+  _mm256_maskstore_epi64((long long*)&K_[i + h], active, K);
+}
+
+// inserts K_(first),...,K_(last) of one row of h keys with vectors of 8 or 4 keys
+__attribute__((target("avx512f")))
+static void row8(int64_t K_[], uint64_t j, const uint64_t last, const uint64_t h)
+{
+  for(; j + 7 <= last; j += 8) {
+    insert8(K_, j, h);
+  }
+  for(; j <= last; ++j) {
+    insert(K_, j, h);
+  }
+}
+
+__attribute__((target("avx2")))
+static void row4(int64_t K_[], uint64_t j, const uint64_t last, const uint64_t h)
+{
+  for(; j + 3 <= last; j += 4) {
+    insert4(K_, j, h);
+  }
+  for(; j <= last; ++j) {
+    insert(K_, j, h);
+  }
+}
+
+#endif
+
+// chains r with first <= r <= last of increment h, sorted by one thread
+struct Chains {
+  int64_t* K_;
+  uint64_t N;
+  uint64_t h;
+  uint64_t first;
+  uint64_t last;
+// lanes of SIMD vectors, 1 for scalar
+  uint64_t W;
+};
+
+// sorts the chains of c a row of h keys at a time
+static int sortChains(void* arg)
+{
+
+  const struct Chains* c = arg;
+
+  int64_t* const K_ = c->K_;
+  const uint64_t N = c->N;
+  const uint64_t h = c->h;
+
+// D2 [Loop on j] row b holds K_(bh+1),...,K_(bh+h), keys of row 0 are already in place
+  for(uint64_t b = h; b + c->first <= N; b += h) {
+
+    const uint64_t first = b + c->first;
+    const uint64_t last = b + c->last < N ? b + c->last : N;
+
+#ifdef SHELLSORT_SIMD_X86
+    if(c->W == 8) {
+      row8(K_, first, last, h);
+      continue;
+    }
+    if(c->W == 4) {
+      row4(K_, first, last, h);
+      continue;
+    }
+#endif
+
+    for(uint64_t j = first; j <= last; ++j) {
+      insert(K_, j, h);
+    }
+  }
+
+  return 0;
+}
+
+// SortChains takes array K_ of N elements beginning at K_[1]
+// SortChains implements Algorithm D with the chains of each h split over T threads when h >= THREAD_H
+// and keys of neighboring chains inserted together with SIMD vectors if simd is true
+// K_ is sorted in place
+void SortChains(const uint64_t N, int64_t K_[N], const uint64_t t, uint64_t H[t], const uint64_t T, const bool simd)
+{
+
+// lanes of SIMD vectors chosen by CPU features at run time
+  uint64_t W = 1;
+
+#ifdef SHELLSORT_SIMD_X86
+  if(simd && __builtin_cpu_supports("avx512f")) {
+    W = 8;
+  } else if(simd && __builtin_cpu_supports("avx2")) {
+    W = 4;
+  }
+#else
+  (void)simd;
+#endif
+
+  struct Chains chains[T];
+  thrd_t thread[T];
+
+// D1 [Loop on s] Perform D2 for s = t - 1, t - 2,..., 0
+  for(uint64_t s = t; s-- > 0;) {
+
+    const uint64_t h = H[s];
+    const uint64_t P = h >= THREAD_H ? T : 1;
+
+    for(uint64_t p = 0; p < P; ++p) {
+      chains[p] = (struct Chains){K_, N, h, h / P * p + h % P * p / P + 1, h / P * (p + 1) + h % P * (p + 1) / P, h >= W ? W : 1};
+    }
+
+// chains of part 0 are sorted by the calling thread
+    for(uint64_t p = 1; p < P; ++p) {
+      if(thrd_create(&thread[p], sortChains, &chains[p]) != thrd_success) {
+        fprintf(stderr, "error: thrd_create failure\n");
+        exit(2);
+      }
+    }
+
+    sortChains(&chains[0]);
+
+    for(uint64_t p = 1; p < P; ++p) {
+      thrd_join(thread[p], NULL);
+    }
+  }
+
+}
+
+// Algorithm D serial and scalar, or by chains with threads or SIMD
+static void shellsort(const uint64_t N, int64_t K_[N], const uint64_t t, uint64_t H[t], const uint64_t T, const bool simd)
+{
+  if(T <= 1 && !simd) {
+    Sort(N, K_, t, H);
+  } else {
+    SortChains(N, K_, t, H, T, simd);
+  }
+}
+
+// next pseudorandom key of xorshift64* for timing
+static int64_t random64(uint64_t* x)
+{
+  *x ^= *x >> 12;
+  *x ^= *x << 25;
+  *x ^= *x >> 27;
+  return *x * UINT64_C(2685821657736338717);
+}
+
+static double seconds()
+{
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// times each named sequence sorting the same N random keys, best of 3 runs
+// saves the increments of the fastest to file
+static void autotune(const uint64_t N, const char* file, const uint64_t T, const bool simd)
+{
+
+// keys to sort and the copy sorted by each run
+  int64_t* keys = malloc((N + 1) * sizeof(*keys));
+  int64_t* R = malloc((N + 1) * sizeof(*R));
+
+  if(keys == NULL || R == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  uint64_t x = 88172645463325252;
+  for(uint64_t i = 1; i <= N; ++i) {
+    keys[i] = random64(&x);
+  }
+
+  uint64_t H[INCREMENTS_MAX];
+  uint64_t best = 0;
+  double bestTime = 0;
+
+  for(uint64_t q = 0; q < SEQUENCE_COUNT; ++q) {
+
+    const uint64_t t = increments(q, N, H);
+
+    double fastest = 0;
+
+    for(int run = 0; run < 3; ++run) {
+      memcpy(&R[1], &keys[1], N * sizeof(*R));
+      const double start = seconds();
+      shellsort(N, R, t, H, T, simd);
+      const double elapsed = seconds() - start;
+      if(run == 0 || elapsed < fastest)
+        fastest = elapsed;
+    }
+
+    printf("%s %.3f ms\n", SEQUENCES[q], fastest * 1e3);
+
+    if(q == 0 || fastest < bestTime) {
+      best = q;
+      bestTime = fastest;
+    }
+  }
+
+  const uint64_t t = increments(best, N, H);
+
+  FILE* f = fopen(file, "wb");
+
+  if(f == NULL || fwrite(&t, sizeof t, 1, f) != 1 || fwrite(H, sizeof(*H), t, f) != t || fclose(f) != 0) {
+    fprintf(stderr, "error: write %s failure\n", file);
+    exit(2);
+  }
+
+  printf("%s saved to %s\n", SEQUENCES[best], file);
+
+  free(R);
+  free(keys);
+}
+
+// reads t and increments H from f, checks that h_0 = 1
+static uint64_t readIncrements(FILE* f, uint64_t H[INCREMENTS_MAX])
+{
+
+  uint64_t t;
+
+  if(fread(&t, sizeof t, 1, f) != 1 || t == 0 || t > INCREMENTS_MAX || fread(H, sizeof(*H), t, f) != t || H[0] != 1) {
+    fprintf(stderr, "Invalid input data: increments must be uint64_t t, 0 < t <= %d, then t increments beginning with 1\n", INCREMENTS_MAX);
+    usage();
+    exit(1);
+  }
+
+  return t;
+}
+
 int main(int argc, char* argv[])
 {
 
-  if(argc > 1) {
+// number of named sequence, SEQUENCE_COUNT for increments from input or table
+  uint64_t q = SEQUENCE_COUNT;
+
+// table file of increments
+  const char* file = NULL;
+
+// number of keys to autotune for, 0 to sort
+  uint64_t tune = 0;
+
+// number of threads
+  uint64_t T = 1;
+
+// insert keys of neighboring chains with SIMD vectors
+  bool simd = false;
+
+  for(int opt; (opt = getopt(argc, argv, "a:f:hs:t:v")) != -1;) {
+    switch(opt) {
+      case 't':
+        T = strtoull(optarg, NULL, 10);
+        break;
+      case 'v':
+        simd = true;
+        break;
+      case 'a':
+        tune = strtoull(optarg, NULL, 10);
+        if(tune == 0) {
+          usage();
+          exit(1);
+        }
+        break;
+      case 'f':
+        file = optarg;
+        break;
+      case 's':
+        q = sequence(optarg);
+        if(q == SEQUENCE_COUNT) {
+          usage();
+          exit(1);
+        }
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind < argc || T == 0 || T > THREADS_MAX || (q < SEQUENCE_COUNT && (file != NULL || tune != 0))) {
     usage();
-    exit(0);
+    exit(1);
+  }
+
+  if(tune != 0) {
+    autotune(tune, file == NULL ? TABLE_FILE : file, T, simd);
+    return 0;
   }
 
 // read 64-bit size of data array as binary data
@@ -102,23 +583,36 @@ int main(int argc, char* argv[])
 
 // read array R of records as binary data
 // allocate N+1 entries to use array indexing from 1 instead of 0
-  int64_t R[N + 1];
+// array is too big for the stack when sorting large inputs
+  int64_t* R = malloc((N + 1) * sizeof(*R));
+
+  if(R == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
   fread(&R[1], sizeof(*R), N, stdin);
 
-// read 64-bit size of increments array as binary data
+  uint64_t H[INCREMENTS_MAX];
   uint64_t t;
-  fread(&t, sizeof t, 1, stdin);
-
-// read array of 64-bit increments as binary data
-  uint64_t H[t];
-  fread(H, sizeof(*H), t, stdin);
 
-  if(H[0] != 1) {
-    usage();
-    exit(1);
+  if(q < SEQUENCE_COUNT) {
+    t = increments(q, N, H);
+  } else if(file != NULL) {
+    FILE* f = fopen(file, "rb");
+    if(f == NULL) {
+      fprintf(stderr, "error: open %s failure\n", file);
+      exit(2);
+    }
+// a table tuned for a larger N has increments too large for this N
+    t = below(N, readIncrements(f, H), H);
+    fclose(f);
+  } else {
+// read 64-bit size of increments array and increments as binary data
+    t = readIncrements(stdin, H);
   }
 
-  Sort(N, R, t, H);
+  shellsort(N, R, t, H, T, simd);
 
 // write number of values to follow
   fwrite(&N, sizeof N, 1, stdout);
@@ -126,7 +620,7 @@ int main(int argc, char* argv[])
 // print sorted array as binary data
   fwrite(&R[1], sizeof(*R), N, stdout);
 
+  free(R);
+
   return 0;
 }
-
-
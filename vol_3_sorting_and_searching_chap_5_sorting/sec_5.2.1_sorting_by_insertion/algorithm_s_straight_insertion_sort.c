@@ -3,19 +3,33 @@
 // Algorithm S (Straight insertion sort)
 // 5.2.1 Sorting by Insertion
 // The Art of Computer Programming, Donald Knuth
+// with binary insertion and two-way insertion
+
+#include "algorithm_s_straight_insertion_sort.h"
 
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>
+
+// names of kernels in order of enum Insertion
+static const char* const KERNELS[] = {"straight", "binary", "two-way"};
 
+#ifdef ALGORITHM_S_STRAIGHT_INSERTION_SORT_BUILD_MAIN
 static void usage()
 {
-  puts("usage:algorithm_s_straight_insertion_sort <in.dat >out.dat");
+  puts("usage:algorithm_s_straight_insertion_sort [-i straight | binary | two-way] <in.dat >out.dat");
 
   puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
 
+  puts("");
+  puts("-i: insertion to use, default is straight");
+  puts("straight: Algorithm S, compares K_j with K_(j-1), K_(j-2),... till its place is found");
+  puts("binary: finds the place of K_j by binary search, about lg j comparisons, and moves the greater keys up with one memmove");
+  puts("two-way: binary search in an output area of 2N-1 keys that starts with K_1 in the middle, moves the keys on the shorter side of the place");
+
   puts("first uint64_t is number of values to sort");
   puts("next that many int64_t is data to sort");
 
@@ -32,13 +46,23 @@ static void usage()
   puts("");
   puts("examples:");
   puts("algorithm_s_straight_insertion_sort <data/algorithm_s_straight_insertion_sort/in.0.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_s_straight_insertion_sort -i two-way <data/algorithm_s_straight_insertion_sort/in.0.le.dat | od -An -td8 -w8 -v");
 }
+#endif
 
+enum Insertion insertion_kernel(const char* name)
+{
+  enum Insertion kernel = 0;
+  while(kernel < INSERTION_COUNT && strcmp(name, KERNELS[kernel]) != 0) {
+    ++kernel;
+  }
+  return kernel;
+}
 
-// Sort takes array K_ of N elements beginning at K_[1]
-// Sort implements Algorithm S (Straight insertion sort)
+// straight_insertion takes array K_ of N elements beginning at K_[1]
+// straight_insertion implements Algorithm S (Straight insertion sort)
 // K_ is sorted in place
-void Sort(const uint64_t N, int64_t K_[N])
+void straight_insertion(const uint64_t N, int64_t K_[N + 1])
 {
 
 // S1 [Loop on j] Perform S2 through S5 for j = 2, 3, ..., N
@@ -75,10 +99,131 @@ void Sort(const uint64_t N, int64_t K_[N])
 
 }
 
+// number of keys among X_l,...,X_r not greater than K, X_l,...,X_r sorted
+// K goes after them so equal keys keep their order
+static uint64_t rank(const int64_t X[], uint64_t l, uint64_t r, const int64_t K)
+{
+  const uint64_t first = l;
+
+// binary search on l <= place <= r + 1 with X_(place-1) <= K < X_place
+  while(l <= r) {
+    const uint64_t i = l + (r - l) / 2;
+    if(K < X[i]) {
+      r = i - 1;
+    } else {
+      l = i + 1;
+    }
+  }
+
+  return l - first;
+}
+
+// binary_insertion takes array K_ of N elements beginning at K_[1]
+// binary_insertion implements binary insertion of 5.2.1
+// K_ is sorted in place
+void binary_insertion(const uint64_t N, int64_t K_[N + 1])
+{
+
+  for(uint64_t j = 2; j <= N; ++j) {
+
+// K_j stays where it is if K_(j-1) <= K_j, one comparison for keys already in order
+    if(K_[j - 1] <= K_[j])
+      continue;
+
+    const int64_t K = K_[j];
+
+// K_j goes to R_(i+1) after the i keys not greater than it, K_(j-1) > K_j so i < j - 1
+    const uint64_t i = rank(K_, 1, j - 2, K);
+
+// R_(i+1),...,R_(j-1) move up together
+    memmove(&K_[i + 2], &K_[i + 1], (j - 1 - i) * sizeof(*K_));
+    K_[i + 1] = K;
+
+  }
+
+}
+
+// two_way_insertion takes array K_ of N elements beginning at K_[1] and workspace X of 2N-1 elements beginning at X[1]
+// two_way_insertion implements two-way insertion of 5.2.1
+// K_ is sorted in place
+void two_way_insertion(const uint64_t N, int64_t K_[N + 1], int64_t X[2 * N])
+{
+
+  if(N < 2)
+    return;
+
+// sorted keys are X_l,...,X_r, the first key goes in the middle
+// there is room for N - 1 keys on either side so neither end can run out
+  uint64_t l = N;
+  uint64_t r = N;
+
+  X[N] = K_[1];
+
+  for(uint64_t j = 2; j <= N; ++j) {
+
+    const int64_t K = K_[j];
+
+// place is X_p, keys X_l,...,X_(p-1) are not greater than K
+    const uint64_t p = l + rank(X, l, r, K);
+
+    if(p - l < r + 1 - p) {
+// fewer keys on the left, X_l,...,X_(p-1) move down
+      memmove(&X[l - 1], &X[l], (p - l) * sizeof(*X));
+      X[p - 1] = K;
+      --l;
+    } else {
+// fewer keys on the right, X_p,...,X_r move up
+      memmove(&X[p + 1], &X[p], (r + 1 - p) * sizeof(*X));
+      X[p] = K;
+      ++r;
+    }
+
+  }
+
+  memcpy(&K_[1], &X[l], N * sizeof(*K_));
+}
+
+void insertion_sort(const uint64_t N, int64_t K_[N + 1], int64_t X[2 * N], const enum Insertion kernel)
+{
+  switch(kernel) {
+    case INSERTION_BINARY:
+      binary_insertion(N, K_);
+      break;
+    case INSERTION_TWO_WAY:
+      two_way_insertion(N, K_, X);
+      break;
+    default:
+      straight_insertion(N, K_);
+  }
+}
+
+#ifdef ALGORITHM_S_STRAIGHT_INSERTION_SORT_BUILD_MAIN
+
 int main(int argc, char* argv[])
 {
 
-  if(argc > 1) {
+  enum Insertion kernel = INSERTION_STRAIGHT;
+
+  for(int opt; (opt = getopt(argc, argv, "hi:")) != -1;) {
+    switch(opt) {
+      case 'h':
+        usage();
+        exit(0);
+      case 'i':
+        kernel = insertion_kernel(optarg);
+        if(kernel == INSERTION_COUNT) {
+          fprintf(stderr, "Invalid input data: -i must be straight, binary or two-way\n");
+          usage();
+          exit(1);
+        }
+        break;
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind < argc) {
     usage();
     exit(0);
   }
@@ -92,7 +237,20 @@ int main(int argc, char* argv[])
   int64_t R[N + 1];
   fread(&R[1], sizeof(*R), N, stdin);
 
-  Sort(N, R);
+// workspace for two-way insertion
+  int64_t* X = NULL;
+
+  if(kernel == INSERTION_TWO_WAY) {
+    X = malloc(2 * N * sizeof(*X));
+    if(X == NULL && N > 0) {
+      fprintf(stderr, "error: malloc failure\n");
+      exit(2);
+    }
+  }
+
+  insertion_sort(N, R, X, kernel);
+
+  free(X);
 
 // write number of values to follow
   fwrite(&N, sizeof N, 1, stdout);
@@ -103,4 +261,4 @@ int main(int argc, char* argv[])
   return 0;
 }
 
-
+#endif
@@ -0,0 +1,36 @@
+#ifndef ALGORITHM_S_STRAIGHT_INSERTION_SORT_H
+#define ALGORITHM_S_STRAIGHT_INSERTION_SORT_H
+
+// Algorithm S (Straight insertion sort)
+// with binary insertion and two-way insertion
+// 5.2.1 Sorting by Insertion
+// The Art of Computer Programming, Donald Knuth
+
+#include <stdint.h>
+
+// insertion sorts used as small-sort kernels by other sorts
+enum Insertion {
+  INSERTION_STRAIGHT,
+  INSERTION_BINARY,
+  INSERTION_TWO_WAY,
+  INSERTION_COUNT
+};
+
+// kernel with name straight, binary or two-way, INSERTION_COUNT if there is none
+enum Insertion insertion_kernel(const char* name);
+
+// sorts K_1,...,K_N in place by Algorithm S, K_j is compared with K_(j-1), K_(j-2),... till its place is found
+void straight_insertion(const uint64_t N, int64_t K_[N + 1]);
+
+// sorts K_1,...,K_N in place, the place of K_j is found by binary search among K_1,...,K_(j-1)
+// with about lg j comparisons and the greater keys are moved up together
+void binary_insertion(const uint64_t N, int64_t K_[N + 1]);
+
+// sorts K_1,...,K_N in place by two-way insertion in X_1,...,X_(2N-1) beginning with K_1 in X_N
+// the place of each key is found by binary search and the keys on the shorter side of it are moved
+void two_way_insertion(const uint64_t N, int64_t K_[N + 1], int64_t X[2 * N]);
+
+// sorts K_1,...,K_N in place with kernel, X is only used by two-way insertion
+void insertion_sort(const uint64_t N, int64_t K_[N + 1], int64_t X[2 * N], const enum Insertion kernel);
+
+#endif
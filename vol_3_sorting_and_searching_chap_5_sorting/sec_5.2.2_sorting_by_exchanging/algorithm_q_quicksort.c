@@ -5,19 +5,27 @@
 // The Art of Computer Programming, Donald Knuth
 // uses stack as described in algorithm
 
+#include "algorithm_q_quicksort.h"
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <math.h>
+#include <unistd.h>
 
+#ifdef ALGORITHM_Q_QUICKSORT_BUILD_MAIN
 static void usage()
 {
-  puts("usage:algorithm_q_quicksort <in.dat >out.dat");
+  puts("usage:algorithm_q_quicksort [-i straight | binary | two-way] <in.dat >out.dat");
 
   puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
 
+  puts("");
+  puts("-i: insertion for subfiles of at most M = 12 keys, default is straight in one pass at the end as in Q9");
+  puts("binary and two-way insertion of 5.2.1 use fewer comparisons and sort each subfile when it is left");
+
   puts("first uint64_t is number of values to sort");
   puts("next that many int64_t is data to sort");
 
@@ -34,7 +42,9 @@ static void usage()
   puts("");
   puts("examples:");
   puts("algorithm_q_quicksort <data/algorithm_q_quicksort/in.0.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_q_quicksort -i binary <data/algorithm_q_quicksort/in.0.le.dat | od -An -td8 -w8 -v");
 }
+#endif
 
 // straight_insertion_sort
 // implements Algorithm 5.2.1S (Straight insertion sort)
@@ -72,6 +82,15 @@ static void straight_insertion_sort(const uint64_t N, int64_t K_[N+1])
 
 }
 
+// sorts subfile K_l,...,K_r with kernel unless kernel is straight insertion, which is left for Q9
+// X is workspace for two-way insertion
+static void subfile(int64_t K_[], const uint64_t l, const uint64_t r, int64_t X[], const enum Insertion kernel)
+{
+  if(kernel != INSERTION_STRAIGHT && l < r) {
+    insertion_sort(r - l + 1, &K_[l - 1], X, kernel);
+  }
+}
+
 // entry object of partition parameters to keep on stack
 struct entry_t {
 
@@ -87,15 +106,27 @@ struct entry_t {
 // Sort implements Algorithm Q (Quicksort)
 // K is sorted in place
 void Sort(const uint64_t N, int64_t K_[N + 2])
+{
+  SortKernel(N, K_, INSERTION_STRAIGHT);
+}
+
+void SortKernel(const uint64_t N, int64_t K_[N + 2], const enum Insertion kernel)
 {
 
 // threshold length to switch to insertion sort
   const uint64_t M = 12;
 
+// workspace for two-way insertion of a subfile
+  int64_t X[2 * M];
+
 // Q1 [Initialize] To Q9 if N <= M
   if(N <= M) {
 // Q9 [Straight insertion sort]
-    straight_insertion_sort(N, K_);
+    if(kernel == INSERTION_STRAIGHT) {
+      straight_insertion_sort(N, K_);
+    } else {
+      insertion_sort(N, K_, X, kernel);
+    }
     return;
   }
 
@@ -191,6 +222,7 @@ void Sort(const uint64_t N, int64_t K_[N + 2])
 // Q7 [Put on stack] To Q2, l <- j + 1 if r - j > M >= j - l
 // left partition is shorter than threshold length
     if(r - j > M && M >= j - l) {
+      subfile(K_, l, j - 1, X, kernel);
 // move left boundary up and continue working on right partition
       l = j + 1;
       continue;
@@ -199,12 +231,15 @@ void Sort(const uint64_t N, int64_t K_[N + 2])
 // Q7 [Put on stack] To Q2, r <- j - 1 if j - l > M >= r - j
 // right partition is shorter than threshold length
     if(j - l > M && M >= r - j) {
+      subfile(K_, j + 1, r, X, kernel);
 // move right boundary down and continue working on left partition
       r = j - 1;
       continue;
     }
 
 // both partitions are shorter than threshold length for insertion sort
+    subfile(K_, l, j - 1, X, kernel);
+    subfile(K_, j + 1, r, X, kernel);
 
 // Q8 [Take off stack]
     if(STACK_SIZE == 0) {
@@ -224,14 +259,39 @@ void Sort(const uint64_t N, int64_t K_[N + 2])
 
 // Q9 [Straight insertion sort]
 // sort entire array with insertion sort
-  straight_insertion_sort(N, K_);
+  if(kernel == INSERTION_STRAIGHT) {
+    straight_insertion_sort(N, K_);
+  }
 
 }
 
+#ifdef ALGORITHM_Q_QUICKSORT_BUILD_MAIN
+
 int main(int argc, char* argv[])
 {
 
-  if(argc > 1) {
+  enum Insertion kernel = INSERTION_STRAIGHT;
+
+  for(int opt; (opt = getopt(argc, argv, "hi:")) != -1;) {
+    switch(opt) {
+      case 'h':
+        usage();
+        exit(0);
+      case 'i':
+        kernel = insertion_kernel(optarg);
+        if(kernel == INSERTION_COUNT) {
+          fprintf(stderr, "Invalid input data: -i must be straight, binary or two-way\n");
+          usage();
+          exit(1);
+        }
+        break;
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind < argc) {
     usage();
     exit(0);
   }
@@ -249,7 +309,7 @@ int main(int argc, char* argv[])
 
   fread(&R[1], sizeof(*R), N, stdin);
 
-  Sort(N, R);
+  SortKernel(N, R, kernel);
 
 // write number of values to follow
   fwrite(&N, sizeof N, 1, stdout);
@@ -260,3 +320,4 @@ int main(int argc, char* argv[])
   return 0;
 }
 
+#endif
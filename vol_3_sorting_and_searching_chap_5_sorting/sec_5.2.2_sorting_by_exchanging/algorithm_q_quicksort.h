@@ -0,0 +1,20 @@
+#ifndef ALGORITHM_Q_QUICKSORT_H
+#define ALGORITHM_Q_QUICKSORT_H
+
+// Algorithm Q (Quicksort)
+// 5.2.2 Sorting by Exchanging
+// The Art of Computer Programming, Donald Knuth
+
+#include "../sec_5.2.1_sorting_by_insertion/algorithm_s_straight_insertion_sort.h"
+
+#include <stdint.h>
+
+// sorts K_1,...,K_N in place, K_0 must be INT64_MIN and K_(N+1) must be INT64_MAX
+void Sort(const uint64_t N, int64_t K_[N + 2]);
+
+// same as Sort with subfiles of at most M keys sorted by kernel
+// straight insertion is done in one pass at the end as in Q9
+// other kernels sort each subfile as soon as it is left by Q7, since a pass over keys nearly in order gains nothing from them
+void SortKernel(const uint64_t N, int64_t K_[N + 2], const enum Insertion kernel);
+
+#endif
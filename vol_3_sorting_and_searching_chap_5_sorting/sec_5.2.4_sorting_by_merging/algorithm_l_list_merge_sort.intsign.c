@@ -0,0 +1,298 @@
+// algorithm_l_list_merge_sort.intsign.c
+
+// Algorithm L (List merge sort)
+// 5.2.4 Sorting by Merging
+// The Art of Computer Programming, Donald Knuth
+// The MMIX Supplement, Martin Ruckert
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+// Algorithm L needs a sign on links that can be 0, and -0 must differ from +0
+// the signbit variant keeps links as double for the ieee-754 sign bit and calls copysign for |L_s| <- p
+// here links are uint64_t with bit 63 as the sign and the rest as the magnitude
+// so |L_s| <- p is an and and an or, -p flips bit 63, and p > 0 is a signed compare of the same bits
+// since a set sign bit makes the 64-bit value negative, -0 included
+
+// links are followed from record to record in memory order that has nothing to do with the order of the keys
+// so once R no longer fits in cache nearly every R_p and R_q of step L3 misses
+// the links of R_p and R_q are in hand at L3 and one of them is the next record compared
+// so both are prefetched before the comparison
+
+// -a leaves the records in sorted order in R_1,...,R_N instead of a sorted list
+// each record moves once, by the rearrangement of Knuth's exercise 5.2-12 due to MacLaren
+
+#define SIGN (UINT64_C(1) << 63)
+
+// magnitude of link
+#define MAG(l) ((l) & ~SIGN)
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(a) __builtin_prefetch(a)
+#else
+#define PREFETCH(a)
+#endif
+
+static void usage()
+{
+  puts("usage:algorithm_l_list_merge_sort.intsign [-a] <in.dat >out.dat");
+  puts("Implements Algorithm L (List merge sort), 5.2.4 Sorting by Merging, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
+
+  puts("first uint64_t is number of values to sort");
+  puts("next that many int64_t is data to sort");
+
+  puts("");
+  puts("binary input data format");
+  puts("uint64_t N");
+  puts("int64_t[N] data");
+
+  puts("");
+  puts("binary output data format");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("-a: rearrange records into sorted order in the array after sorting the list");
+
+  puts("");
+  puts("examples:");
+  puts("algorithm_l_list_merge_sort.intsign <data/algorithm_l_list_merge_sort.intsign/in.0.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_l_list_merge_sort.intsign -a <data/algorithm_l_list_merge_sort.intsign/in.1.le.dat | od -An -td8 -w8 -v");
+}
+
+struct Record {
+// link field, bit 63 is the sign
+  uint64_t L;
+// key field
+  int64_t K;
+};
+
+// Sort takes array R of N + 2 records
+// Sort implements Algorithm L (List merge sort)
+// R_0.L is the head of the sorted list
+void Sort(const uint64_t N; struct Record R[N + 2], const uint64_t N)
+{
+
+// boundary cases
+  if(N == 0) {
+    R[0].L = 0;
+    return;
+  }
+
+  if(N == 1) {
+    R[0].L = 1;
+    R[1].L = 0;
+    return;
+  }
+
+// algorithm assumes N >= 2
+
+// L1 [Prepare two lists] L_0 <- 1, L_(N + 1) <- 2
+// L_0 is head of list with odd indexes, R_1, R_3, R_5, ...
+  R[0].L = 1;
+
+// L_(N + 1) is head of list with even indexes, R_2, R_4, R_6, ...
+  R[N + 1].L = 2;
+
+// L1 [Prepare two lists] L_i <- -(i + 2) for 1 <= i <= N - 2
+  for(uint64_t i = 1; i + 2 <= N; ++i) {
+    R[i].L = SIGN | (i + 2);
+  }
+
+// L1 [Prepare two lists] L_(N -  1) <- L_N <- 0
+// R_(N - 1) and R_N are the end of the two lists
+  R[N - 1].L = R[N].L = 0;
+
+  for(;;) {
+
+// L2 [Begin new pass] s <- 0, t <- N + 1, p <- L_s, q <- L_t
+// the heads of the two lists
+    uint64_t s = 0;
+    uint64_t t = N + 1;
+
+    uint64_t p = R[s].L;
+    uint64_t q = R[t].L;
+
+// L2 [Begin new pass] Terminate if q = 0
+    if(MAG(q) == 0)
+      return;
+
+    for(;;) {
+
+// the next record compared is R_(L_p) or R_(L_q)
+      PREFETCH(&R[MAG(R[p].L)]);
+      PREFETCH(&R[MAG(R[q].L)]);
+
+// L3 [Compare K_p:K_q] To L6 if K_p > K_q
+      if(R[p].K > R[q].K) {
+
+// L6 [Advance q] |L_s| <- q, s <- q, q <- L_q
+        R[s].L = (R[s].L & SIGN) | q;
+        s = q;
+        q = R[q].L;
+
+// L6 [Advance q] To L3 if q > 0
+        if((int64_t)q > 0)
+          continue;
+
+// L7 [Complete the sublist] L_s <- p, s <- t
+        R[s].L = p;
+        s = t;
+
+// L7 [Complete the sublist] t <- p, p <- L_p till p <= 0
+        do {
+          t = p;
+          p = R[p].L;
+        } while((int64_t)p > 0);
+
+      } else {
+
+// L4 [Advance p] |L_s| <- p, s <- p, p <- L_p
+        R[s].L = (R[s].L & SIGN) | p;
+        s = p;
+        p = R[p].L;
+
+// L4 [Advance p] To L3 if p > 0
+        if((int64_t)p > 0)
+          continue;
+
+// L5 [Complete the sublist] L_s <- q, s <- t
+        R[s].L = q;
+        s = t;
+
+// L5 [Complete the sublist] t <- q, q <- L_q till q <= 0
+        do {
+          t = q;
+          q = R[q].L;
+        } while((int64_t)q > 0);
+
+// L5 [Complete the sublist] To L8
+      }
+
+// L8 [End of pass?] p <- -p, q <- -q
+      p ^= SIGN;
+      q ^= SIGN;
+
+// L8 [End of pass?] |L_s| <- p, |L_t| <- 0
+      if(MAG(q) == 0) {
+        R[s].L = (R[s].L & SIGN) | p;
+        R[t].L &= SIGN;
+// L8 [End of pass?] To L2
+        break;
+      }
+
+// L8 [End of pass?] To L3
+
+    }
+
+  }
+
+}
+
+// Rearrange moves the records of the sorted list beginning at L_0 into R_1,...,R_N
+// when R_i is filled the record there moves to the place p of the record taken
+// and L_i <- p leaves a forwarding address, so a list link below i is followed till it reaches i or beyond
+void Rearrange(const uint64_t N; struct Record R[N + 2], const uint64_t N)
+{
+
+  uint64_t p = MAG(R[0].L);
+
+  for(uint64_t i = 1; i <= N; ++i) {
+
+// follow forwarding addresses of records already moved
+    while(p < i) {
+      p = MAG(R[p].L);
+    }
+
+    const uint64_t q = MAG(R[p].L);
+
+    if(p != i) {
+      const struct Record tmp = R[i];
+      R[i] = R[p];
+      R[p] = tmp;
+      R[i].L = p;
+    }
+
+    p = q;
+  }
+
+}
+
+int main(int argc, char* argv[])
+{
+
+// rearrange records into an array
+  bool array = false;
+
+  for(int opt; (opt = getopt(argc, argv, "ah")) != -1;) {
+    switch(opt) {
+      case 'a':
+        array = true;
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind < argc) {
+    usage();
+    exit(1);
+  }
+
+// read 64-bit size of data array as binary data
+  uint64_t N;
+  fread(&N, sizeof N, 1, stdin);
+
+// allocate N+2 entries for extra artificial records at index 0 and N+1
+// array is too big for the stack when sorting large inputs
+  struct Record* R = malloc((N + 2) * sizeof(*R));
+  int64_t* out = malloc((N + 1) * sizeof(*out));
+
+  if(R == NULL || out == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+// read keys as binary data and fill key field of each record
+  fread(&out[1], sizeof(*out), N, stdin);
+
+  for(uint64_t i = 1; i <= N; ++i) {
+    R[i].K = out[i];
+  }
+
+  Sort(R, N);
+
+  if(array) {
+    Rearrange(R, N);
+    for(uint64_t i = 1; i <= N; ++i) {
+      out[i] = R[i].K;
+    }
+  } else {
+// traverse linked list to collect sorted keys
+    uint64_t k = 1;
+    for(uint64_t i = MAG(R[0].L); i != 0; i = MAG(R[i].L)) {
+      out[k++] = R[i].K;
+    }
+  }
+
+// write number of values to follow
+  fwrite(&N, sizeof N, 1, stdout);
+
+// print sorted keys as binary data
+  fwrite(&out[1], sizeof(*out), N, stdout);
+
+  free(out);
+  free(R);
+
+  return 0;
+}
@@ -0,0 +1,314 @@
+// algorithm_l_list_merge_sort.natural.c
+
+// Algorithm L (List merge sort)
+// 5.2.4 Sorting by Merging
+// The Art of Computer Programming, Donald Knuth
+// The MMIX Supplement, Martin Ruckert
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+// Algorithm L starts from N sublists of one record each, put alternately on two lists by L1
+// but the links can just as well describe sublists of any length
+// here L1 links each natural run of the input into one sublist without moving any records
+// an ascending run R_i <= ... <= R_j is linked i, i + 1, ..., j
+// a strictly descending run R_i > ... > R_j is linked backwards j, j - 1, ..., i, which keeps equal keys in order
+// runs then go alternately on the two lists as single records do in L1
+// a file with m runs needs ceiling(lg m) passes instead of ceiling(lg N), and sorted input needs none
+
+// links are uint64_t with bit 63 as the sign as in algorithm_l_list_merge_sort.intsign
+// and the successors of R_p and R_q are prefetched before step L3
+
+// -a leaves the records in sorted order in R_1,...,R_N instead of a sorted list
+// each record moves once, by the rearrangement of Knuth's exercise 5.2-12 due to MacLaren
+
+#define SIGN (UINT64_C(1) << 63)
+
+// magnitude of link
+#define MAG(l) ((l) & ~SIGN)
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(a) __builtin_prefetch(a)
+#else
+#define PREFETCH(a)
+#endif
+
+static void usage()
+{
+  puts("usage:algorithm_l_list_merge_sort.natural [-a] <in.dat >out.dat");
+  puts("Implements Algorithm L (List merge sort), 5.2.4 Sorting by Merging, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
+
+  puts("first uint64_t is number of values to sort");
+  puts("next that many int64_t is data to sort");
+
+  puts("");
+  puts("binary input data format");
+  puts("uint64_t N");
+  puts("int64_t[N] data");
+
+  puts("");
+  puts("binary output data format");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("-a: rearrange records into sorted order in the array after sorting the list");
+
+  puts("");
+  puts("examples:");
+  puts("algorithm_l_list_merge_sort.natural <data/algorithm_l_list_merge_sort.natural/in.0.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_l_list_merge_sort.natural -a <data/algorithm_l_list_merge_sort.natural/in.1.le.dat | od -An -td8 -w8 -v");
+}
+
+struct Record {
+// link field, bit 63 is the sign
+  uint64_t L;
+// key field
+  int64_t K;
+};
+
+// Sort takes array R of N + 2 records
+// Sort implements Algorithm L (List merge sort)
+// R_0.L is the head of the sorted list
+void Sort(const uint64_t N; struct Record R[N + 2], const uint64_t N)
+{
+
+// boundary cases
+  if(N == 0) {
+    R[0].L = 0;
+    return;
+  }
+
+// L1 [Prepare two lists] natural runs go alternately on the list at L_0 and the list at L_(N + 1)
+// last[h] is the record whose link gets the head of the next sublist of list h
+  uint64_t last[2] = {0, N + 1};
+
+  for(uint64_t i = 1, h = 0; i <= N; h ^= 1) {
+
+// run R_i,...,R_j has head and tail in the order of its keys
+    uint64_t j = i, head, tail;
+
+    if(j < N && R[j + 1].K < R[j].K) {
+      while(j < N && R[j + 1].K < R[j].K) {
+        ++j;
+      }
+      for(uint64_t k = i + 1; k <= j; ++k) {
+        R[k].L = k - 1;
+      }
+      head = j;
+      tail = i;
+    } else {
+      while(j < N && R[j].K <= R[j + 1].K) {
+        ++j;
+      }
+      for(uint64_t k = i; k < j; ++k) {
+        R[k].L = k + 1;
+      }
+      head = i;
+      tail = j;
+    }
+
+// L_0 and L_(N + 1) point to the first sublist, the end of a sublist points to the next one with a minus sign
+    R[last[h]].L = last[h] == 0 || last[h] == N + 1 ? head : SIGN | head;
+    last[h] = tail;
+
+    i = j + 1;
+  }
+
+// L1 [Prepare two lists] the last sublist of each list ends with link 0
+// the list at L_(N + 1) is empty when the input is one run
+  R[last[0]].L = R[last[1]].L = 0;
+
+  for(;;) {
+
+// L2 [Begin new pass] s <- 0, t <- N + 1, p <- L_s, q <- L_t
+// the heads of the two lists
+    uint64_t s = 0;
+    uint64_t t = N + 1;
+
+    uint64_t p = R[s].L;
+    uint64_t q = R[t].L;
+
+// L2 [Begin new pass] Terminate if q = 0
+    if(MAG(q) == 0)
+      return;
+
+    for(;;) {
+
+// the next record compared is R_(L_p) or R_(L_q)
+      PREFETCH(&R[MAG(R[p].L)]);
+      PREFETCH(&R[MAG(R[q].L)]);
+
+// L3 [Compare K_p:K_q] To L6 if K_p > K_q
+      if(R[p].K > R[q].K) {
+
+// L6 [Advance q] |L_s| <- q, s <- q, q <- L_q
+        R[s].L = (R[s].L & SIGN) | q;
+        s = q;
+        q = R[q].L;
+
+// L6 [Advance q] To L3 if q > 0
+        if((int64_t)q > 0)
+          continue;
+
+// L7 [Complete the sublist] L_s <- p, s <- t
+        R[s].L = p;
+        s = t;
+
+// L7 [Complete the sublist] t <- p, p <- L_p till p <= 0
+        do {
+          t = p;
+          p = R[p].L;
+        } while((int64_t)p > 0);
+
+      } else {
+
+// L4 [Advance p] |L_s| <- p, s <- p, p <- L_p
+        R[s].L = (R[s].L & SIGN) | p;
+        s = p;
+        p = R[p].L;
+
+// L4 [Advance p] To L3 if p > 0
+        if((int64_t)p > 0)
+          continue;
+
+// L5 [Complete the sublist] L_s <- q, s <- t
+        R[s].L = q;
+        s = t;
+
+// L5 [Complete the sublist] t <- q, q <- L_q till q <= 0
+        do {
+          t = q;
+          q = R[q].L;
+        } while((int64_t)q > 0);
+
+// L5 [Complete the sublist] To L8
+      }
+
+// L8 [End of pass?] p <- -p, q <- -q
+      p ^= SIGN;
+      q ^= SIGN;
+
+// L8 [End of pass?] |L_s| <- p, |L_t| <- 0
+      if(MAG(q) == 0) {
+        R[s].L = (R[s].L & SIGN) | p;
+        R[t].L &= SIGN;
+// L8 [End of pass?] To L2
+        break;
+      }
+
+// L8 [End of pass?] To L3
+
+    }
+
+  }
+
+}
+
+// Rearrange moves the records of the sorted list beginning at L_0 into R_1,...,R_N
+// when R_i is filled the record there moves to the place p of the record taken
+// and L_i <- p leaves a forwarding address, so a list link below i is followed till it reaches i or beyond
+void Rearrange(const uint64_t N; struct Record R[N + 2], const uint64_t N)
+{
+
+  uint64_t p = MAG(R[0].L);
+
+  for(uint64_t i = 1; i <= N; ++i) {
+
+// follow forwarding addresses of records already moved
+    while(p < i) {
+      p = MAG(R[p].L);
+    }
+
+    const uint64_t q = MAG(R[p].L);
+
+    if(p != i) {
+      const struct Record tmp = R[i];
+      R[i] = R[p];
+      R[p] = tmp;
+      R[i].L = p;
+    }
+
+    p = q;
+  }
+
+}
+
+int main(int argc, char* argv[])
+{
+
+// rearrange records into an array
+  bool array = false;
+
+  for(int opt; (opt = getopt(argc, argv, "ah")) != -1;) {
+    switch(opt) {
+      case 'a':
+        array = true;
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind < argc) {
+    usage();
+    exit(1);
+  }
+
+// read 64-bit size of data array as binary data
+  uint64_t N;
+  fread(&N, sizeof N, 1, stdin);
+
+// allocate N+2 entries for extra artificial records at index 0 and N+1
+// array is too big for the stack when sorting large inputs
+  struct Record* R = malloc((N + 2) * sizeof(*R));
+  int64_t* out = malloc((N + 1) * sizeof(*out));
+
+  if(R == NULL || out == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+// read keys as binary data and fill key field of each record
+  fread(&out[1], sizeof(*out), N, stdin);
+
+  for(uint64_t i = 1; i <= N; ++i) {
+    R[i].K = out[i];
+  }
+
+  Sort(R, N);
+
+  if(array) {
+    Rearrange(R, N);
+    for(uint64_t i = 1; i <= N; ++i) {
+      out[i] = R[i].K;
+    }
+  } else {
+// traverse linked list to collect sorted keys
+    uint64_t k = 1;
+    for(uint64_t i = MAG(R[0].L); i != 0; i = MAG(R[i].L)) {
+      out[k++] = R[i].K;
+    }
+  }
+
+// write number of values to follow
+  fwrite(&N, sizeof N, 1, stdout);
+
+// print sorted keys as binary data
+  fwrite(&out[1], sizeof(*out), N, stdout);
+
+  free(out);
+  free(R);
+
+  return 0;
+}
@@ -4,16 +4,50 @@
 // 5.2.4 Sorting by Merging
 // The Art of Computer Programming, Donald Knuth
 
+#include "algorithm_m_two_way_merge.h"
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <math.h>
-
+#include <threads.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MERGE_SIMD_X86
+#endif
+
+// most threads for -t
+#define THREADS_MAX 1024
+
+// merge_path splits the merge of x and y into p pieces that are merged independently
+// the merge of x and y is a path through the m by n grid of pairs (i, j)
+// the path moves right when x_i is output and down when y_j is output
+// each diagonal i + j = k of the grid crosses the path exactly once
+// the crossing is found by binary search along the diagonal by corank
+// the diagonals k = (m + n) * t / p for 0 <= t <= p cut the path into p pieces of nearly equal length
+// piece t merges x_(i_t + 1),...,x_(i_(t+1)) and y_(j_t + 1),...,y_(j_(t+1)) into z_(k_t + 1),...,z_(k_(t+1))
+// pieces write to disjoint parts of z so threads need no synchronization
+// ties are broken the same way as by merge so the output is identical
+
+// merge_simd replaces the compare and branch of M2 for every key with a bitonic merge network on vector registers
+// register a holds the W largest keys merged so far in order, W = 4 keys with AVX2, W = 8 with AVX-512
+// each step loads the next W keys of x or y, whichever has the smaller next key, into register b
+// the network merges a and b, writes the W smallest keys to z and keeps the W largest in a
+// keys still unread are never smaller than those written since the next block is taken from the smaller side
+// b is reversed so a followed by b is bitonic, min and max of a and b then split it into
+// two bitonic halves with every key of the low half <= every key of the high half
+// each half is sorted by exchanging keys at distance W/2, W/4, ..., 1
+// the network does not keep equal keys in input order but the keys are plain integers so the output is identical
+// the kernel is chosen at run time by CPU features, with merge as the scalar fallback
+
+#ifdef ALGORITHM_M_TWO_WAY_MERGE_BUILD_MAIN
 static void usage()
 {
-  puts("usage:algorithm_m_two_way_merge <in.dat >out.dat");
+  puts("usage:algorithm_m_two_way_merge [-t threads] [-v] <in.dat >out.dat");
 
   puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
 
@@ -32,10 +66,17 @@ static void usage()
   puts("uint64_t N");
   puts("int64_t[N] sorted data");
 
+  puts("");
+  puts("-t: number of threads for merge-path merge, 1 to 1024, default is 1 for serial merge");
+  puts("-v: merge with SIMD bitonic merge kernel, AVX-512 or AVX2 chosen at run time, scalar merge if neither is available");
+
   puts("");
   puts("examples:");
   puts("algorithm_m_two_way_merge <data/algorithm_m_two_way_merge/in.0.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_m_two_way_merge -t 4 <data/algorithm_m_two_way_merge/in.1.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_m_two_way_merge -v <data/algorithm_m_two_way_merge/in.2.le.dat | od -An -td8 -w8 -v");
 }
+#endif
 
 void merge(const uint64_t m, const uint64_t n; int64_t x[m+1], const uint64_t m, int64_t y[n+1], const uint64_t n, int64_t z[m+n+1])
 {
@@ -103,34 +144,365 @@ void merge(const uint64_t m, const uint64_t n; int64_t x[m+1], const uint64_t m,
 
 }
 
+// merge_tail finishes merge_simd after x or y has fewer than W keys left
+// t holds the W largest keys merged so far in order
+// keys of t, x_i,...,x_m and y_j,...,y_n are merged into z_k,...,z_(m+n)
+static void merge_tail(const uint64_t W, const uint64_t m, const uint64_t n; const int64_t t[W], const uint64_t W, int64_t x[m+1], uint64_t i, const uint64_t m, int64_t y[n+1], uint64_t j, const uint64_t n, int64_t z[m+n+1], uint64_t k)
+{
+
+  for(uint64_t a = 0; a < W;) {
+    if(i <= m && x[i] <= t[a] && (j > n || x[i] <= y[j])) {
+      z[k++] = x[i++];
+    } else if(j <= n && y[j] < t[a]) {
+      z[k++] = y[j++];
+    } else {
+      z[k++] = t[a++];
+    }
+  }
+
+// pointers are offset so the rest of x and y is again indexed from 1
+  merge(&x[i - 1], m - i + 1, &y[j - 1], n - j + 1, &z[k - 1]);
+}
+
+#ifdef MERGE_SIMD_X86
+
+// min and max of 4 keys, AVX2 has a 64-bit compare but no 64-bit min or max
+__attribute__((target("avx2")))
+static inline __m256i min4(const __m256i a, const __m256i b)
+{
+  return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i max4(const __m256i a, const __m256i b)
+{
+  return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b));
+}
+
+// sorts bitonic vector v of 4 keys
+__attribute__((target("avx2")))
+static inline __m256i bitonic4(__m256i v)
+{
+// exchange keys at distance 2 by swapping 128-bit halves
+  __m256i w = _mm256_permute4x64_epi64(v, 0x4e);
+  v = _mm256_blend_epi32(min4(v, w), max4(v, w), 0xf0);
+
+// exchange keys at distance 1 by swapping keys within each half
+  w = _mm256_shuffle_epi32(v, 0x4e);
+  v = _mm256_blend_epi32(min4(v, w), max4(v, w), 0xcc);
+
+  return v;
+}
+
+// merges sorted vectors a and b of 4 keys, smallest 4 go to *lo and largest 4 to *hi
+__attribute__((target("avx2")))
+static inline void bitonic_merge4(__m256i* lo, __m256i* hi, const __m256i a, __m256i b)
+{
+  b = _mm256_permute4x64_epi64(b, 0x1b);
+  *lo = bitonic4(min4(a, b));
+  *hi = bitonic4(max4(a, b));
+}
+
+__attribute__((target("avx2")))
+static void merge_avx2(const uint64_t m, const uint64_t n; int64_t x[m+1], const uint64_t m, int64_t y[n+1], const uint64_t n, int64_t z[m+n+1])
+{
+
+  if(m < 4 || n < 4) {
+    merge(x, m, y, n, z);
+    return;
+  }
+
+  __m256i a = _mm256_loadu_si256((const void*)&x[1]);
+  __m256i b = _mm256_loadu_si256((const void*)&y[1]);
+  __m256i lo;
+
+  uint64_t i = 5, j = 5, k = 1;
+
+  bitonic_merge4(&lo, &a, a, b);
+  _mm256_storeu_si256((void*)&z[k], lo);
+  k += 4;
+
+  while(i + 3 <= m && j + 3 <= n) {
+
+// next block from the side with the smaller next key, like M2
+    if(x[i] <= y[j]) {
+      b = _mm256_loadu_si256((const void*)&x[i]);
+      i += 4;
+    } else {
+      b = _mm256_loadu_si256((const void*)&y[j]);
+      j += 4;
+    }
+
+    bitonic_merge4(&lo, &a, a, b);
+    _mm256_storeu_si256((void*)&z[k], lo);
+    k += 4;
+  }
+
+  int64_t t[4];
+  _mm256_storeu_si256((void*)t, a);
+
+  merge_tail(t, 4, x, i, m, y, j, n, z, k);
+}
+
+// sorts bitonic vector v of 8 keys
+__attribute__((target("avx512f")))
+static inline __m512i bitonic8(__m512i v)
+{
+// _mm512_set_epi64 lists index of key 7 first
+  const __m512i d4 = _mm512_set_epi64(3, 2, 1, 0, 7, 6, 5, 4);
+  const __m512i d2 = _mm512_set_epi64(5, 4, 7, 6, 1, 0, 3, 2);
+  const __m512i d1 = _mm512_set_epi64(6, 7, 4, 5, 2, 3, 0, 1);
+
+// exchange keys at distance 4, 2, 1, upper key of each pair takes the max
+  __m512i w = _mm512_permutexvar_epi64(d4, v);
+  v = _mm512_mask_blend_epi64(0xf0, _mm512_min_epi64(v, w), _mm512_max_epi64(v, w));
+
+  w = _mm512_permutexvar_epi64(d2, v);
+  v = _mm512_mask_blend_epi64(0xcc, _mm512_min_epi64(v, w), _mm512_max_epi64(v, w));
+
+  w = _mm512_permutexvar_epi64(d1, v);
+  v = _mm512_mask_blend_epi64(0xaa, _mm512_min_epi64(v, w), _mm512_max_epi64(v, w));
+
+  return v;
+}
+
+// merges sorted vectors a and b of 8 keys, smallest 8 go to *lo and largest 8 to *hi
+__attribute__((target("avx512f")))
+static inline void bitonic_merge8(__m512i* lo, __m512i* hi, const __m512i a, __m512i b)
+{
+  b = _mm512_permutexvar_epi64(_mm512_set_epi64(0, 1, 2, 3, 4, 5, 6, 7), b);
+  *lo = bitonic8(_mm512_min_epi64(a, b));
+  *hi = bitonic8(_mm512_max_epi64(a, b));
+}
+
+__attribute__((target("avx512f")))
+static void merge_avx512(const uint64_t m, const uint64_t n; int64_t x[m+1], const uint64_t m, int64_t y[n+1], const uint64_t n, int64_t z[m+n+1])
+{
+
+  if(m < 8 || n < 8) {
+    merge(x, m, y, n, z);
+    return;
+  }
+
+  __m512i a = _mm512_loadu_si512(&x[1]);
+  __m512i b = _mm512_loadu_si512(&y[1]);
+  __m512i lo;
+
+  uint64_t i = 9, j = 9, k = 1;
+
+  bitonic_merge8(&lo, &a, a, b);
+  _mm512_storeu_si512(&z[k], lo);
+  k += 8;
+
+  while(i + 7 <= m && j + 7 <= n) {
+
+// next block from the side with the smaller next key, like M2
+    if(x[i] <= y[j]) {
+      b = _mm512_loadu_si512(&x[i]);
+      i += 8;
+    } else {
+      b = _mm512_loadu_si512(&y[j]);
+      j += 8;
+    }
+
+    bitonic_merge8(&lo, &a, a, b);
+    _mm512_storeu_si512(&z[k], lo);
+    k += 8;
+  }
+
+  int64_t t[8];
+  _mm512_storeu_si512(t, a);
+
+  merge_tail(t, 8, x, i, m, y, j, n, z, k);
+}
+
+#endif
+
+void merge_simd(const uint64_t m, const uint64_t n; int64_t x[m+1], const uint64_t m, int64_t y[n+1], const uint64_t n, int64_t z[m+n+1])
+{
+
+#ifdef MERGE_SIMD_X86
+  if(__builtin_cpu_supports("avx512f")) {
+    merge_avx512(x, m, y, n, z);
+    return;
+  }
+
+  if(__builtin_cpu_supports("avx2")) {
+    merge_avx2(x, m, y, n, z);
+    return;
+  }
+#endif
+
+  merge(x, m, y, n, z);
+}
+
+// corank returns i such that the first k keys output by merge are x_1,...,x_i and y_1,...,y_(k-i)
+// i is the smallest value in range with y_(k-i) < x_(i+1), ties go to x first like M2
+uint64_t corank(const uint64_t m, const uint64_t n; const int64_t x[m+1], const uint64_t m, const int64_t y[n+1], const uint64_t n, const uint64_t k)
+{
+
+// i must leave no more than n keys of y and take no more than m keys of x
+  uint64_t lo = k > n ? k - n : 0;
+  uint64_t hi = k < m ? k : m;
+
+// the test is false below the crossing and true from it on
+  while(lo < hi) {
+    const uint64_t i = lo + (hi - lo) / 2;
+    if(y[k - i] < x[i + 1]) {
+      hi = i;
+    } else {
+      lo = i + 1;
+    }
+  }
+
+  return lo;
+}
+
+// piece of merge_path merged by one thread
+struct Piece {
+  int64_t* x;
+  uint64_t m;
+  int64_t* y;
+  uint64_t n;
+  int64_t* z;
+  bool simd;
+};
+
+static int mergePiece(void* arg)
+{
+  struct Piece* piece = arg;
+
+  if(piece->simd) {
+    merge_simd(piece->x, piece->m, piece->y, piece->n, piece->z);
+  } else {
+    merge(piece->x, piece->m, piece->y, piece->n, piece->z);
+  }
+
+  return 0;
+}
+
+void merge_path(const uint64_t m, const uint64_t n; int64_t x[m+1], const uint64_t m, int64_t y[n+1], const uint64_t n, int64_t z[m+n+1], const uint64_t p, const bool simd)
+{
+
+  if(p <= 1 || m + n < p) {
+    mergePiece(&(struct Piece){x, m, y, n, z, simd});
+    return;
+  }
+
+// crossing of the path with diagonal k_t
+  uint64_t* const i = malloc((p + 1) * sizeof *i);
+  uint64_t* const k = malloc((p + 1) * sizeof *k);
+
+// pieces and their threads
+  struct Piece* const piece = malloc(p * sizeof *piece);
+  thrd_t* const thread = malloc(p * sizeof *thread);
+
+  if(i == NULL || k == NULL || piece == NULL || thread == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  i[0] = k[0] = 0;
+  i[p] = m;
+  k[p] = m + n;
+
+  for(uint64_t t = 1; t < p; ++t) {
+    k[t] = (m + n) / p * t + (m + n) % p * t / p;
+    i[t] = corank(x, m, y, n, k[t]);
+  }
+
+// pointers are offset so each piece is again indexed from 1
+
+  for(uint64_t t = 0; t < p; ++t) {
+    const uint64_t j = k[t] - i[t];
+    piece[t] = (struct Piece){&x[i[t]], i[t + 1] - i[t], &y[j], k[t + 1] - i[t + 1] - j, &z[k[t]], simd};
+  }
+
+// piece 0 is merged by the calling thread
+  for(uint64_t t = 1; t < p; ++t) {
+    if(thrd_create(&thread[t], mergePiece, &piece[t]) != thrd_success) {
+      fprintf(stderr, "error: thrd_create failure\n");
+      exit(2);
+    }
+  }
+
+  mergePiece(&piece[0]);
+
+  for(uint64_t t = 1; t < p; ++t) {
+    thrd_join(thread[t], NULL);
+  }
+
+  free(thread);
+  free(piece);
+  free(k);
+  free(i);
+
+}
+
+#ifdef ALGORITHM_M_TWO_WAY_MERGE_BUILD_MAIN
+
 int main(int argc, char* argv[])
 {
 
-  if(argc > 1) {
+// number of threads
+  uint64_t p = 1;
+
+// merge with SIMD kernel
+  bool simd = false;
+
+  for(int opt; (opt = getopt(argc, argv, "ht:v")) != -1;) {
+    switch(opt) {
+      case 't':
+        p = strtoull(optarg, NULL, 10);
+        break;
+      case 'v':
+        simd = true;
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind < argc || p == 0 || p > THREADS_MAX) {
     usage();
-    exit(0);
+    exit(1);
   }
 
   uint64_t m;
   fread(&m, sizeof m, 1, stdin);
 
-// read array X of values as binary data
-  int64_t X[m + 1];
+// arrays are too big for the stack when merging large columns
+// allocate m+1 entries to use array indexing from 1 instead of 0
+  int64_t* X = malloc((m + 1) * sizeof(*X));
 
+  if(X == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+// read array X of values as binary data
   fread(&X[1], sizeof(*X), m, stdin);
 
 // read 64-bit size of Y array as binary data
   uint64_t n;
   fread(&n, sizeof n, 1, stdin);
 
-// read array Y of values as binary data
-  int64_t Y[n + 1];
+  int64_t* Y = malloc((n + 1) * sizeof(*Y));
+  int64_t* Z = malloc((m + n + 1) * sizeof(*Z));
 
-  fread(&Y[1], sizeof(*Y), n, stdin);
+  if(Y == NULL || Z == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
 
-  int64_t Z[m + n + 1];
+// read array Y of values as binary data
+  fread(&Y[1], sizeof(*Y), n, stdin);
 
-  merge(X, m, Y, n, Z);
+  merge_path(X, m, Y, n, Z, p, simd);
 
 // write number of values to follow
   const uint64_t zsize = m + n;
@@ -139,6 +511,11 @@ int main(int argc, char* argv[])
 // print sorted array as binary data
   fwrite(&Z[1], sizeof(*Z), zsize, stdout);
 
+  free(Z);
+  free(Y);
+  free(X);
+
   return 0;
 }
 
+#endif
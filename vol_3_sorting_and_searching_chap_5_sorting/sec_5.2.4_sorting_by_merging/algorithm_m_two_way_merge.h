@@ -0,0 +1,25 @@
+#ifndef ALGORITHM_M_TWO_WAY_MERGE_H
+#define ALGORITHM_M_TWO_WAY_MERGE_H
+
+// Algorithm M (Two-way merge)
+// 5.2.4 Sorting by Merging
+// The Art of Computer Programming, Donald Knuth
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// merges x_1 <= ... <= x_m and y_1 <= ... <= y_n into z_1 <= ... <= z_(m+n)
+// equal keys of x come before those of y
+void merge(const uint64_t m, const uint64_t n; int64_t x[m+1], const uint64_t m, int64_t y[n+1], const uint64_t n, int64_t z[m+n+1]);
+
+// same output as merge with a SIMD bitonic merge kernel chosen by CPU features at run time
+void merge_simd(const uint64_t m, const uint64_t n; int64_t x[m+1], const uint64_t m, int64_t y[n+1], const uint64_t n, int64_t z[m+n+1]);
+
+// number of keys from x among the first k keys output by merge
+uint64_t corank(const uint64_t m, const uint64_t n; const int64_t x[m+1], const uint64_t m, const int64_t y[n+1], const uint64_t n, const uint64_t k);
+
+// same output as merge with the work split over p threads along the merge path
+// each piece is merged by merge_simd if simd is true
+void merge_path(const uint64_t m, const uint64_t n; int64_t x[m+1], const uint64_t m, int64_t y[n+1], const uint64_t n, int64_t z[m+n+1], const uint64_t p, const bool simd);
+
+#endif
@@ -0,0 +1,462 @@
+// algorithm_m_two_way_merge.sets.c
+
+// Set operations on sorted files with Algorithm M (Two-way merge)
+// 5.2.4 Sorting by Merging
+// The Art of Computer Programming, Donald Knuth
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SETS_SIMD_X86
+#endif
+
+// union, intersection, difference and symmetric difference of sorted x and y
+// are the merge of Algorithm M with step M2 deciding what to do with x_i and y_j
+// x_i < y_j means x_i is not in y, x_i > y_j means y_j is not in x, and x_i = y_j is a key in both
+// the inputs are taken as sets, so a key repeated in a file counts once and every key is output at most once
+
+// an intersection of a small x with a large y takes O(m log(n/m)) comparisons instead of O(m + n)
+// by galloping: each x_i is looked up in y_j,...,y_n by comparing y_(j+1), y_(j+2), y_(j+4), ...
+// till one is >= x_i and then by binary search within the last gap
+// this is chosen when one file has more than GALLOP_RATIO times as many keys as the other
+
+// for files of similar size the intersection compares blocks of 4 keys of x with blocks of 4 keys of y
+// with AVX2, the block of y is rotated 3 times so all 16 pairs are compared for equality in 4 instructions
+// then the block with the smaller last key is replaced, both if their last keys are equal
+// the compare is branch free, the only branch left is which block to advance, where M2 had one per key
+
+#define GALLOP_RATIO 32
+
+static void usage()
+{
+  puts("usage:algorithm_m_two_way_merge.sets -u | -i | -d | -s [-g | -v | -m] x.dat y.dat >z.dat");
+  puts("Implements set operations with Algorithm M (Two-way merge), 5.2.4 Sorting by Merging, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads sorted 64-bit values as binary data from two files, outputs sorted 64-bit values as binary data");
+  puts("keys repeated in a file count once, every key is output at most once");
+
+  puts("");
+  puts("binary input data format of each file");
+  puts("uint64_t N, can be 0 for empty file");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("binary output data format");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("-u: union, keys in x or y");
+  puts("-i: intersection, keys in both x and y");
+  puts("-d: difference, keys in x and not in y");
+  puts("-s: symmetric difference, keys in exactly one of x and y");
+
+  puts("");
+  puts("intersection is by galloping when one file has more than 32 times as many keys as the other, by SIMD blocks otherwise");
+  puts("-g: intersection by galloping");
+  puts("-v: intersection by SIMD blocks, AVX2 checked at run time, merge if not available");
+  puts("-m: intersection by merge");
+
+  puts("");
+  puts("examples:");
+  puts("algorithm_m_two_way_merge.sets -i data/algorithm_m_two_way_merge.sets/in.7.x.le.dat data/algorithm_m_two_way_merge.sets/in.7.y.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_m_two_way_merge.sets -i data/algorithm_m_two_way_merge.sets/in.8.x.le.dat data/algorithm_m_two_way_merge.sets/in.8.y.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_m_two_way_merge.sets -i -v data/algorithm_m_two_way_merge.sets/in.9.x.le.dat data/algorithm_m_two_way_merge.sets/in.9.y.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_m_two_way_merge.sets -d <(algorithm_s_straight_two_way_merge_sort <in.0.le.dat) <(algorithm_s_straight_two_way_merge_sort <in.1.le.dat) | od -An -td8 -w8 -v");
+}
+
+// appends key to z_1,...,z_(k-1) unless it equals the last key output
+// returns new value of k
+static inline uint64_t output(int64_t z[], uint64_t k, const int64_t key)
+{
+  z[k] = key;
+  return k + (k == 1 || z[k - 1] != key);
+}
+
+// M4 and M6 transmit x_i,...,x_m to z starting at z_k
+// returns new value of k
+static uint64_t transmit(const uint64_t m; const int64_t x[m+1], uint64_t i, const uint64_t m, int64_t z[], uint64_t k)
+{
+  for(; i <= m; ++i) {
+    k = output(z, k, x[i]);
+  }
+  return k;
+}
+
+// all set operations return the number of keys in z, which has room for m + n keys
+
+// keys of x or y
+uint64_t set_union(const uint64_t m, const uint64_t n; const int64_t x[m+1], const uint64_t m, const int64_t y[n+1], const uint64_t n, int64_t z[m+n+1])
+{
+
+// M1 [Initialize] i <- 1, j <- 1, k <- 1
+  uint64_t i = 1, j = 1, k = 1;
+
+  while(i <= m && j <= n) {
+
+// M2 [Find smaller] both are output when x_i = y_j, the second is dropped by output
+    if(x[i] <= y[j]) {
+// M3 [Output x_i]
+      k = output(z, k, x[i]);
+      ++i;
+    } else {
+// M5 [Output y_j]
+      k = output(z, k, y[j]);
+      ++j;
+    }
+  }
+
+// M4 [Transmit y_j,...,y_n] or M6 [Transmit x_i,...,x_m]
+  k = transmit(x, i, m, z, k);
+  k = transmit(y, j, n, z, k);
+
+  return k - 1;
+}
+
+// merges x_i,...,x_m and y_j,...,y_n outputting keys in both to z starting at z_k
+// returns new value of k
+static uint64_t intersect(const uint64_t m, const uint64_t n; const int64_t x[m+1], uint64_t i, const uint64_t m, const int64_t y[n+1], uint64_t j, const uint64_t n, int64_t z[], uint64_t k)
+{
+
+  while(i <= m && j <= n) {
+
+// M2 [Find smaller] only keys in both are output, the smaller is skipped
+    if(x[i] < y[j]) {
+      ++i;
+    } else if(x[i] > y[j]) {
+      ++j;
+    } else {
+      k = output(z, k, x[i]);
+      ++i;
+      ++j;
+    }
+  }
+
+// nothing left in one file is in the other, M4 and M6 transmit nothing
+
+  return k;
+}
+
+// keys of x and y by merge
+uint64_t set_intersection_merge(const uint64_t m, const uint64_t n; const int64_t x[m+1], const uint64_t m, const int64_t y[n+1], const uint64_t n, int64_t z[m+n+1])
+{
+// M1 [Initialize] i <- 1, j <- 1, k <- 1
+  return intersect(x, 1, m, y, 1, n, z, 1) - 1;
+}
+
+// smallest index p with j <= p <= n and key <= y_p, n + 1 if there is none
+// probes y_j, y_(j+1), y_(j+2), y_(j+4), ... then searches the last gap by binary search
+static uint64_t gallop(const uint64_t n; const int64_t y[n+1], const uint64_t j, const uint64_t n, const int64_t key)
+{
+
+  if(j > n || key <= y[j])
+    return j;
+
+// y_lo < key, and y_hi >= key if hi <= n
+  uint64_t lo = j, step = 1;
+  uint64_t hi = j + step;
+
+  while(hi <= n && y[hi] < key) {
+    lo = hi;
+    step *= 2;
+    hi = j + step;
+  }
+
+  if(hi > n + 1)
+    hi = n + 1;
+
+  while(hi - lo > 1) {
+    const uint64_t mid = lo + (hi - lo) / 2;
+    if(y[mid] < key) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return hi;
+}
+
+// keys of x and y by galloping through y, best when m is much smaller than n
+uint64_t set_intersection_gallop(const uint64_t m, const uint64_t n; const int64_t x[m+1], const uint64_t m, const int64_t y[n+1], const uint64_t n, int64_t z[m+n+1])
+{
+
+  uint64_t j = 1, k = 1;
+
+  for(uint64_t i = 1; i <= m && j <= n; ++i) {
+
+// skip keys of y smaller than x_i
+    j = gallop(y, j, n, x[i]);
+
+    if(j <= n && y[j] == x[i]) {
+      k = output(z, k, x[i]);
+    }
+  }
+
+  return k - 1;
+}
+
+#ifdef SETS_SIMD_X86
+
+// keys of x and y by comparing blocks of 4 keys with AVX2
+__attribute__((target("avx2")))
+static uint64_t set_intersection_avx2(const uint64_t m, const uint64_t n; const int64_t x[m+1], const uint64_t m, const int64_t y[n+1], const uint64_t n, int64_t z[m+n+1])
+{
+
+  uint64_t i = 1, j = 1, k = 1;
+
+  while(i + 3 <= m && j + 3 <= n) {
+
+    const __m256i a = _mm256_loadu_si256((const void*)&x[i]);
+    __m256i b = _mm256_loadu_si256((const void*)&y[j]);
+
+// compare every key of a with every key of b, rotating b by one key at a time
+    __m256i eq = _mm256_cmpeq_epi64(a, b);
+    b = _mm256_permute4x64_epi64(b, 0x39);
+    eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(a, b));
+    b = _mm256_permute4x64_epi64(b, 0x39);
+    eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(a, b));
+    b = _mm256_permute4x64_epi64(b, 0x39);
+    eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(a, b));
+
+// bit r is set when x_(i+r) is in the block of y
+    for(unsigned mask = _mm256_movemask_pd(_mm256_castsi256_pd(eq)); mask != 0; mask &= mask - 1) {
+      k = output(z, k, x[i + __builtin_ctz(mask)]);
+    }
+
+// replace the block with the smaller last key, like M2 for blocks
+    const int64_t xlast = x[i + 3];
+    const int64_t ylast = y[j + 3];
+    i += xlast <= ylast ? 4 : 0;
+    j += ylast <= xlast ? 4 : 0;
+  }
+
+// fewer than 4 keys left in x or y
+  return intersect(x, i, m, y, j, n, z, k) - 1;
+}
+
+#endif
+
+// keys of x and y by SIMD blocks, by merge if AVX2 is not available
+uint64_t set_intersection_simd(const uint64_t m, const uint64_t n; const int64_t x[m+1], const uint64_t m, const int64_t y[n+1], const uint64_t n, int64_t z[m+n+1])
+{
+
+#ifdef SETS_SIMD_X86
+  if(__builtin_cpu_supports("avx2"))
+    return set_intersection_avx2(x, m, y, n, z);
+#endif
+
+  return set_intersection_merge(x, m, y, n, z);
+}
+
+// keys of x and y, by galloping through the larger file when sizes differ by more than GALLOP_RATIO
+uint64_t set_intersection(const uint64_t m, const uint64_t n; const int64_t x[m+1], const uint64_t m, const int64_t y[n+1], const uint64_t n, int64_t z[m+n+1])
+{
+
+  if(m > GALLOP_RATIO * n)
+    return set_intersection_gallop(y, n, x, m, z);
+
+  if(n > GALLOP_RATIO * m)
+    return set_intersection_gallop(x, m, y, n, z);
+
+  return set_intersection_simd(x, m, y, n, z);
+}
+
+// keys of x not in y
+uint64_t set_difference(const uint64_t m, const uint64_t n; const int64_t x[m+1], const uint64_t m, const int64_t y[n+1], const uint64_t n, int64_t z[m+n+1])
+{
+
+  uint64_t i = 1, j = 1, k = 1;
+
+  while(i <= m && j <= n) {
+
+// M2 [Find smaller] x_i is output when it is smaller than y_j
+// j stays when x_i = y_j so further copies of x_i are dropped too
+    if(x[i] < y[j]) {
+      k = output(z, k, x[i]);
+      ++i;
+    } else if(x[i] > y[j]) {
+      ++j;
+    } else {
+      ++i;
+    }
+  }
+
+// M6 [Transmit x_i,...,x_m], the rest of y is not in x
+  k = transmit(x, i, m, z, k);
+
+  return k - 1;
+}
+
+// keys of x or y that are not in both
+uint64_t set_symmetric_difference(const uint64_t m, const uint64_t n; const int64_t x[m+1], const uint64_t m, const int64_t y[n+1], const uint64_t n, int64_t z[m+n+1])
+{
+
+  uint64_t i = 1, j = 1, k = 1;
+
+  while(i <= m && j <= n) {
+
+// M2 [Find smaller] the smaller key is output, a key in both is skipped with all its copies
+    if(x[i] < y[j]) {
+      k = output(z, k, x[i]);
+      ++i;
+    } else if(x[i] > y[j]) {
+      k = output(z, k, y[j]);
+      ++j;
+    } else {
+      const int64_t key = x[i];
+      for(; i <= m && x[i] == key; ++i) {
+      }
+      for(; j <= n && y[j] == key; ++j) {
+      }
+    }
+  }
+
+// M4 [Transmit y_j,...,y_n] or M6 [Transmit x_i,...,x_m]
+  k = transmit(x, i, m, z, k);
+  k = transmit(y, j, n, z, k);
+
+  return k - 1;
+}
+
+// reads sorted file name into memory
+// returns array with keys from index 1 and their number in *n
+static int64_t* readFile(const char* name, uint64_t* n)
+{
+
+  FILE* f = fopen(name, "rb");
+
+  if(f == NULL) {
+    fprintf(stderr, "error: open %s: %s\n", name, strerror(errno));
+    exit(2);
+  }
+
+  if(fread(n, sizeof *n, 1, f) != 1) {
+    fprintf(stderr, "Invalid input data: %s has no number of keys\n", name);
+    usage();
+    exit(1);
+  }
+
+// allocate n+1 entries to use array indexing from 1 instead of 0
+  int64_t* x = malloc((*n + 1) * sizeof(*x));
+
+  if(x == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  const uint64_t got = fread(&x[1], sizeof(*x), *n, f);
+
+  if(got != *n) {
+    fprintf(stderr, "Invalid input data: %s ends %" PRIu64 " keys short\n", name, *n - got);
+    usage();
+    exit(1);
+  }
+
+  fclose(f);
+
+  return x;
+}
+
+int main(int argc, char* argv[])
+{
+
+// set operation
+  int op = 0;
+
+// method of intersection, 0 to choose by sizes
+  int method = 0;
+
+  for(int opt; (opt = getopt(argc, argv, "dghimsuv")) != -1;) {
+    switch(opt) {
+      case 'd':
+      case 'i':
+      case 's':
+      case 'u':
+        if(op != 0) {
+          usage();
+          exit(1);
+        }
+        op = opt;
+        break;
+      case 'g':
+      case 'm':
+      case 'v':
+        method = opt;
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(argc - optind != 2 || op == 0) {
+    usage();
+    exit(1);
+  }
+
+  uint64_t m, n;
+
+  int64_t* X = readFile(argv[optind], &m);
+  int64_t* Y = readFile(argv[optind + 1], &n);
+
+  int64_t* Z = malloc((m + n + 1) * sizeof(*Z));
+
+  if(Z == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  uint64_t zsize = 0;
+
+  switch(op) {
+    case 'u':
+      zsize = set_union(X, m, Y, n, Z);
+      break;
+    case 'd':
+      zsize = set_difference(X, m, Y, n, Z);
+      break;
+    case 's':
+      zsize = set_symmetric_difference(X, m, Y, n, Z);
+      break;
+    case 'i':
+      switch(method) {
+        case 'g':
+// gallop through the larger file
+          zsize = m <= n ? set_intersection_gallop(X, m, Y, n, Z) : set_intersection_gallop(Y, n, X, m, Z);
+          break;
+        case 'm':
+          zsize = set_intersection_merge(X, m, Y, n, Z);
+          break;
+        case 'v':
+          zsize = set_intersection_simd(X, m, Y, n, Z);
+          break;
+        default:
+          zsize = set_intersection(X, m, Y, n, Z);
+      }
+      break;
+  }
+
+// write number of values to follow
+  fwrite(&zsize, sizeof zsize, 1, stdout);
+
+// print result as binary data
+  fwrite(&Z[1], sizeof(*Z), zsize, stdout);
+
+  free(Z);
+  free(Y);
+  free(X);
+
+  return 0;
+}
@@ -0,0 +1,177 @@
+// algorithm_m_two_way_merge.stream.c
+
+// Algorithm M (Two-way merge) for sorted files of any size
+// 5.2.4 Sorting by Merging
+// The Art of Computer Programming, Donald Knuth
+
+#include "sorted_stream.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+// x and y are read from two files or pipes and z is written to stdout
+// only one buffer of keys for each of x, y and z is in memory at a time
+// so memory does not grow with the size of the files
+// buffers are read and written with read and write system calls without stdio in between
+// a buffer is refilled when all its keys have been merged and written out when it is full
+
+// steps M2-M5 run without checking for the end of a buffer as many times as
+// the smallest number of keys left in a buffer, since each step takes one key of x or y and outputs one key of z
+// M4 and M6 transmit the rest of one file block by block
+
+// default number of keys in each buffer, 8 MB
+#define BUFFER_KEYS (UINT64_C(1) << 20)
+
+static void usage()
+{
+  puts("usage:algorithm_m_two_way_merge.stream [-b keys] x.dat y.dat >z.dat");
+  puts("Implements Algorithm M (Two-way merge) for sorted files of any size, 5.2.4 Sorting by Merging, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads sorted 64-bit values as binary data from two files or pipes, outputs merged 64-bit values as binary data");
+  puts("memory used is three buffers no matter how large the files are");
+
+  puts("");
+  puts("binary input data format of each file");
+  puts("uint64_t N, can be 0 for empty file");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("binary output data format");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("-b: number of keys in each buffer, default is 1048576");
+
+  puts("");
+  puts("examples:");
+  puts("algorithm_m_two_way_merge.stream data/algorithm_m_two_way_merge.stream/in.1.x.le.dat data/algorithm_m_two_way_merge.stream/in.1.y.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_m_two_way_merge.stream <(algorithm_s_straight_two_way_merge_sort <in.0.le.dat) <(algorithm_s_straight_two_way_merge_sort <in.1.le.dat) | od -An -td8 -w8 -v");
+}
+
+// M4 and M6 transmit the rest of file s to z
+static void transmit(struct Stream* s, struct Output* z)
+{
+
+  while(stream_fill(s)) {
+
+    const uint64_t avail = s->last - s->next;
+    const uint64_t space = z->keys - z->next;
+    const uint64_t count = avail < space ? avail : space;
+
+    memcpy(&z->buf[z->next], &s->buf[s->next], count * sizeof(*z->buf));
+    s->next += count;
+    z->next += count;
+
+    if(z->next == z->keys)
+      output_flush(z);
+  }
+}
+
+// merges sorted files x and y into z on stdout
+void merge(struct Stream* x, struct Stream* y, struct Output* z)
+{
+
+// M1 [Initialize] buffers of x and y are filled, z is empty
+  bool xleft = stream_fill(x);
+  bool yleft = stream_fill(y);
+
+  while(xleft && yleft) {
+
+// steps that can run before a buffer of x, y or z needs attention
+    uint64_t steps = z->keys - z->next;
+    if(x->last - x->next < steps)
+      steps = x->last - x->next;
+    if(y->last - y->next < steps)
+      steps = y->last - y->next;
+
+    const int64_t* const X = x->buf;
+    const int64_t* const Y = y->buf;
+    int64_t* const Z = z->buf;
+
+    uint64_t i = x->next, j = y->next, k = z->next;
+
+    for(; steps > 0; --steps) {
+
+// M2 [Find smaller] To M3 if x_i <= y_j, to M5 otherwise
+      if(X[i] <= Y[j]) {
+// M3 [Output x_i] z_k <- x_i, k <- k + 1, i <- i + 1
+        Z[k++] = X[i++];
+      } else {
+// M5 [Output y_j] z_k <- y_j, k <- k + 1, j <- j + 1
+        Z[k++] = Y[j++];
+      }
+    }
+
+    x->next = i;
+    y->next = j;
+    z->next = k;
+
+    if(z->next == z->keys)
+      output_flush(z);
+
+    xleft = stream_fill(x);
+    yleft = stream_fill(y);
+  }
+
+// M4 [Transmit y_j,...,y_n] or M6 [Transmit x_i,...,x_m], only one of them has keys left
+  transmit(x, z);
+  transmit(y, z);
+
+  output_flush(z);
+}
+
+int main(int argc, char* argv[])
+{
+
+// number of keys in each buffer
+  uint64_t keys = BUFFER_KEYS;
+
+  for(int opt; (opt = getopt(argc, argv, "b:h")) != -1;) {
+    switch(opt) {
+      case 'b':
+        keys = strtoull(optarg, NULL, 10);
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(argc - optind != 2 || keys == 0) {
+    usage();
+    exit(1);
+  }
+
+  struct Stream x, y;
+
+  stream_open(&x, argv[optind], keys, usage);
+  stream_open(&y, argv[optind + 1], keys, usage);
+
+  struct Output z = {malloc(keys * sizeof(*z.buf)), 0, keys};
+
+  if(z.buf == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+// write number of values to follow
+  const uint64_t zsize = x.unread + y.unread;
+  write_fully(&zsize, sizeof zsize);
+
+  merge(&x, &y, &z);
+
+  free(z.buf);
+
+  stream_close(&y);
+  stream_close(&x);
+
+  return 0;
+}
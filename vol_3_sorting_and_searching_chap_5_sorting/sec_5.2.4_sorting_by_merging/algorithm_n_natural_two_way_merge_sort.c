@@ -4,11 +4,15 @@
 // 5.2.4 Sorting by Merging
 // The Art of Computer Programming, Donald Knuth
 
+#include "algorithm_m_two_way_merge.h"
+#include "merge_in_place.h"
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>
 
 // runs from opposite ends of the array are merged into workspace till
 // forward and backward pointers meet
@@ -27,7 +31,7 @@
 
 static void usage()
 {
-  puts("usage:algorithm_n_natural_two_way_merge_sort <in.dat >out.dat");
+  puts("usage:algorithm_n_natural_two_way_merge_sort [-v | -b | -i] <in.dat >out.dat");
   puts("Implements Algorithm N (Natural two-way merge sort), 5.2.4 Sorting by Merging, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
 
   puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
@@ -45,9 +49,17 @@ static void usage()
   puts("uint64_t N");
   puts("int64_t[N] sorted data");
 
+  puts("");
+  puts("-v: merge passes go left to right with the SIMD bitonic merge kernel of Algorithm M");
+  puts("-b: merge passes go left to right in place with workspace for N/2 keys instead of N");
+  puts("-i: merge passes go left to right in place by blocks with workspace for about sqrt(N) keys");
+
   puts("");
   puts("examples:");
   puts("algorithm_n_natural_two_way_merge_sort <data/algorithm_n_natural_two_way_merge_sort/in.0.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_n_natural_two_way_merge_sort -v <data/algorithm_n_natural_two_way_merge_sort/in.7.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_n_natural_two_way_merge_sort -b <data/algorithm_n_natural_two_way_merge_sort/in.8.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_n_natural_two_way_merge_sort -i <data/algorithm_n_natural_two_way_merge_sort/in.9.le.dat | od -An -td8 -w8 -v");
 }
 
 // Sort takes array K of N elements beginning at K[1]
@@ -221,25 +233,183 @@ void Sort(const uint64_t N; int64_t K[2*N + 1], const uint64_t N)
 
 }
 
+// SortSimd takes array K of N elements beginning at K[1]
+// SortSimd sorts natural runs like Algorithm N but each pass merges adjacent pairs of runs left to right
+// so every merge is a call to merge_simd of Algorithm M instead of steps N3-N11
+// the second half of K is the workspace as in Algorithm N
+// K is sorted in place
+void SortSimd(const uint64_t N; int64_t K[2*N + 1], const uint64_t N)
+{
+
+// source and destination areas, both indexed from 1
+  int64_t* src = K;
+  int64_t* dst = &K[N];
+
+  for(uint64_t i = 1; i <= N;) {
+
+// first run is src_i,...,src_a, ends at stepdown
+    uint64_t a = i;
+    while(a < N && src[a] <= src[a + 1]) {
+      ++a;
+    }
+
+// a single run left from the start of the area means sorting is complete
+    if(i == 1 && a == N)
+      break;
+
+// second run is src_(a+1),...,src_b, empty at end of area
+    uint64_t b = a;
+    if(b < N) {
+      ++b;
+      while(b < N && src[b] <= src[b + 1]) {
+        ++b;
+      }
+    }
+
+// pointers are offset so runs are indexed from 1
+    merge_simd(&src[i - 1], a - i + 1, &src[a], b - a, &dst[i - 1]);
+
+    i = b + 1;
+
+// end of pass, switch areas
+    if(i > N) {
+      int64_t* tmp = src;
+      src = dst;
+      dst = tmp;
+      i = 1;
+    }
+
+  }
+
+// copy workspace to original array if it holds the sorted output
+  if(src != K) {
+    memcpy(&K[1], &src[1], N * sizeof(*K));
+  }
+
+}
+
+// SortInPlace takes array K of N elements beginning at K[1]
+// SortInPlace sorts natural runs like Algorithm N but each pass merges adjacent pairs of runs left to right
+// in place with merge_in_place so there is no second area of N keys
+// W is workspace for s keys and TAG for N / s + 1 block numbers
+// K is sorted in place
+void SortInPlace(const uint64_t N; int64_t K[N + 1], const uint64_t N, int64_t W[], const uint64_t s, uint64_t TAG[])
+{
+
+  for(uint64_t i = 1; i <= N;) {
+
+// first run is K_i,...,K_a, ends at stepdown
+    uint64_t a = i;
+    while(a < N && K[a] <= K[a + 1]) {
+      ++a;
+    }
+
+// a single run left from the start of the array means sorting is complete
+    if(i == 1 && a == N)
+      break;
+
+// second run is K_(a+1),...,K_b, empty at end of array
+    uint64_t b = a;
+    if(b < N) {
+      ++b;
+      while(b < N && K[b] <= K[b + 1]) {
+        ++b;
+      }
+    }
+
+// pointer is offset so runs are indexed from 1
+    merge_in_place(&K[i - 1], a - i + 1, b - a, W, s, TAG);
+
+    i = b + 1;
+
+// end of pass, start next pass
+    if(i > N) {
+      i = 1;
+    }
+
+  }
+
+}
+
 int main(int argc, char* argv[])
 {
 
-  if(argc > 1) {
+// merge passes, 'v' for SIMD kernel, 'b' for N/2 workspace, 'i' for in place by blocks, 0 for Algorithm N
+  int mode = 0;
+
+  for(int opt; (opt = getopt(argc, argv, "bhiv")) != -1;) {
+    switch(opt) {
+      case 'b':
+      case 'i':
+      case 'v':
+        if(mode != 0 && mode != opt) {
+          usage();
+          exit(1);
+        }
+        mode = opt;
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind < argc) {
     usage();
-    exit(0);
+    exit(1);
   }
 
 // read 64-bit size of data array as binary data
   uint64_t N;
   fread(&N, sizeof N, 1, stdin);
 
-// read array R of records as binary data
+// keys in workspace W for merging in place
+  uint64_t s = 0;
+
+  if(mode == 'b') {
+    s = N / 2;
+  } else if(mode == 'i') {
+// s is ceiling of sqrt(N)
+    while(s * s < N) {
+      ++s;
+    }
+  }
+
+  if(s == 0) {
+    s = 1;
+  }
+
+// array of records is too big for the stack when N is large
 // allocate N+1 entries to use array indexing from 1 instead of 0
-// plus extra N entries for merge workspace
-  int64_t R[2*N + 1];
+// plus extra N entries for merge workspace unless merging in place
+  const bool inPlace = mode == 'b' || mode == 'i';
+  int64_t* R = malloc((inPlace ? N + 1 : 2*N + 1) * sizeof(*R));
+  int64_t* W = NULL;
+  uint64_t* TAG = NULL;
+
+  if(inPlace) {
+    W = malloc((s + 1) * sizeof(*W));
+    TAG = malloc((N / s + 1) * sizeof(*TAG));
+  }
+
+  if(R == NULL || (inPlace && (W == NULL || TAG == NULL))) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+// read array R of records as binary data
   fread(&R[1], sizeof(*R), N, stdin);
 
-  Sort(R, N);
+  if(mode == 'v') {
+    SortSimd(R, N);
+  } else if(inPlace) {
+    SortInPlace(R, N, W, s, TAG);
+  } else {
+    Sort(R, N);
+  }
 
 // write number of values to follow
   fwrite(&N, sizeof N, 1, stdout);
@@ -247,6 +417,10 @@ int main(int argc, char* argv[])
 // print sorted array as binary data
   fwrite(&R[1], sizeof(*R), N, stdout);
 
+  free(TAG);
+  free(W);
+  free(R);
+
   return 0;
 }
 
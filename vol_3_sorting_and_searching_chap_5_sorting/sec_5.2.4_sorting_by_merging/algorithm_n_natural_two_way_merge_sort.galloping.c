@@ -0,0 +1,663 @@
+// algorithm_n_natural_two_way_merge_sort.galloping.c
+
+// Algorithm N (Natural two-way merge sort) with minimum run length, run stack and galloping merge
+// 5.2.4 Sorting by Merging
+// The Art of Computer Programming, Donald Knuth
+
+// the run stack, mergeLo, mergeHi, gallopLeft, gallopRight and min_gallop are a port of
+// merge_lo, merge_hi, gallop_left, gallop_right and min_gallop of TimSort by Tim Peters
+// in Objects/listobject.c of CPython, described in Objects/listsort.txt
+// Copyright (c) 2001 Python Software Foundation; All Rights Reserved
+// used under the Python Software Foundation License Version 2, https://docs.python.org/3/license.html
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+// Algorithm N merges natural runs in passes over the whole array
+// every pass touches every key even when most of the array is already in long runs
+// and the merge compares keys one at a time even when one run supplies long stretches of output
+// this variant is the scheme of TimSort and keeps natural runs but changes three things
+
+// runs are found once from left to right as in N3-N12, a strictly descending run is reversed in place
+// a run shorter than minrun is extended to minrun keys by binary insertion
+// minrun is between 32 and 64 and chosen so N / minrun is a power of 2 or a little less
+
+// runs are pushed on a stack and merged with a neighbor when their lengths break the invariants
+// len[k-2] > len[k-1] + len[k] and len[k-1] > len[k] for the top three runs
+// so lengths on the stack grow at least as fast as Fibonacci numbers and merges stay balanced
+// the check also looks one run deeper to keep the invariant for the whole stack
+// at the end the runs left on the stack are merged from the top
+
+// a merge first finds by binary search the keys of the left run already in place before the right run
+// and the keys of the right run already in place after the left run
+// the shorter run of what is left is copied to workspace and merged from the end it shares with the other run
+// when one run supplies min_gallop keys in a row the merge switches to galloping
+// galloping searches for the next key of one run in the other run by exponential then binary search
+// and moves the whole stretch it finds with memmove instead of one comparison per key
+// min_gallop shrinks while galloping pays off and grows when it does not
+
+// keys that are equal keep their original order so the sort is stable like Algorithm N
+// already sorted input is a single run and is done in N - 1 comparisons
+// input made of k sorted batches takes about N lg k comparisons or fewer with galloping
+
+// at most N/2 keys are copied to workspace for a merge, the shorter run is never longer than that
+// so the workspace K[N+1],...,K[N+N/2] after the keys is half the size of the second area of Algorithm N
+
+// mergeLo and mergeHi are merge_lo and merge_hi of TimSort, the shorter run is copied to workspace
+// and the merge alternates between one pair at a time mode and galloping mode, mergeHi goes from the right end
+
+// runs shorter than this are extended to minrun by binary insertion
+#define MIN_MERGE 64u
+
+// initial number of keys in a row from one run before galloping
+#define MIN_GALLOP 7u
+
+// lengths on the stack grow like Fibonacci numbers so this many runs is enough for any 64-bit N
+#define MAX_RUNS 85u
+
+static void usage()
+{
+  puts("usage:algorithm_n_natural_two_way_merge_sort.galloping <in.dat >out.dat");
+  puts("Implements Algorithm N (Natural two-way merge sort) with minimum run length, run stack and galloping merge, 5.2.4 Sorting by Merging, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
+
+  puts("first uint64_t is number of values to sort");
+  puts("next that many int64_t is data to sort");
+
+  puts("");
+  puts("binary input data format");
+  puts("uint64_t N");
+  puts("int64_t[N] data");
+
+  puts("");
+  puts("binary output data format");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("examples:");
+  puts("algorithm_n_natural_two_way_merge_sort.galloping <data/algorithm_n_natural_two_way_merge_sort.galloping/in.0.le.dat | od -An -td8 -w8 -v");
+}
+
+// run of keys a[0],...,a[n-1]
+struct Run {
+  int64_t* a;
+  uint64_t n;
+};
+
+// stack of runs waiting to be merged and workspace for merging
+struct MergeState {
+  struct Run run[MAX_RUNS];
+  uint64_t runs;
+  int64_t* tmp;
+  uint64_t min_gallop;
+};
+
+// minrun for N keys, N itself if N < MIN_MERGE
+// the 6 leading bits of N, plus 1 if any of the remaining bits is 1
+static uint64_t minRun(uint64_t N)
+{
+
+  uint64_t r = 0;
+
+  while(N >= MIN_MERGE) {
+    r |= N & 1;
+    N >>= 1;
+  }
+
+  return N + r;
+}
+
+// length of run at start of a[0],...,a[n-1]
+// a strictly descending run is reversed so every run ends up ascending
+// strict descent is needed so reversing never changes the order of equal keys
+static uint64_t countRun(int64_t a[], const uint64_t n)
+{
+
+  if(n == 1)
+    return 1;
+
+  uint64_t length = 2;
+
+  if(a[1] < a[0]) {
+
+    while(length < n && a[length] < a[length - 1]) {
+      ++length;
+    }
+
+    for(uint64_t i = 0, j = length - 1; i < j; ++i, --j) {
+      const int64_t tmp = a[i];
+      a[i] = a[j];
+      a[j] = tmp;
+    }
+
+  } else {
+
+    while(length < n && a[length] >= a[length - 1]) {
+      ++length;
+    }
+
+  }
+
+  return length;
+}
+
+// sorts a[0],...,a[n-1] by binary insertion, a[0],...,a[start-1] are already sorted
+// key a[i] is inserted after all equal keys so the sort is stable
+static void binaryInsertion(int64_t a[], const uint64_t n, const uint64_t start)
+{
+
+  for(uint64_t i = start; i < n; ++i) {
+
+    const int64_t key = a[i];
+
+// binary search for first key greater than key in a[0],...,a[i-1]
+    uint64_t lo = 0, hi = i;
+    while(lo < hi) {
+      const uint64_t mid = lo + (hi - lo) / 2;
+      if(key < a[mid]) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+
+    memmove(&a[lo + 1], &a[lo], (i - lo) * sizeof(*a));
+    a[lo] = key;
+  }
+}
+
+// gallopLeft returns k such that a[k-1] < key <= a[k] in sorted a[0],...,a[n-1]
+// so key would go before equal keys of a
+// search starts at a[hint] and goes out by steps 1, 3, 7, ... before binary search
+static uint64_t gallopLeft(const int64_t key, const int64_t a[], const uint64_t n, const uint64_t hint)
+{
+
+// a[lastofs] < key <= a[ofs] after galloping, -1 and n stand for minus and plus infinity
+  int64_t lastofs = 0, ofs = 1;
+
+  if(a[hint] < key) {
+
+// gallop right till a[hint + lastofs] < key <= a[hint + ofs]
+    const int64_t maxofs = n - hint;
+    while(ofs < maxofs && a[hint + ofs] < key) {
+      lastofs = ofs;
+      ofs = 2 * ofs + 1;
+    }
+    if(ofs > maxofs)
+      ofs = maxofs;
+
+    lastofs += hint;
+    ofs += hint;
+
+  } else {
+
+// gallop left till a[hint - ofs] < key <= a[hint - lastofs]
+    const int64_t maxofs = hint + 1;
+    while(ofs < maxofs && key <= a[hint - ofs]) {
+      lastofs = ofs;
+      ofs = 2 * ofs + 1;
+    }
+    if(ofs > maxofs)
+      ofs = maxofs;
+
+    const int64_t k = lastofs;
+    lastofs = hint - ofs;
+    ofs = hint - k;
+
+  }
+
+// binary search for answer in lastofs + 1,...,ofs
+  ++lastofs;
+  while(lastofs < ofs) {
+    const int64_t mid = lastofs + (ofs - lastofs) / 2;
+    if(a[mid] < key) {
+      lastofs = mid + 1;
+    } else {
+      ofs = mid;
+    }
+  }
+
+  return ofs;
+}
+
+// gallopRight returns k such that a[k-1] <= key < a[k] in sorted a[0],...,a[n-1]
+// so key would go after equal keys of a
+static uint64_t gallopRight(const int64_t key, const int64_t a[], const uint64_t n, const uint64_t hint)
+{
+
+// a[lastofs] <= key < a[ofs] after galloping
+  int64_t lastofs = 0, ofs = 1;
+
+  if(key < a[hint]) {
+
+// gallop left till a[hint - ofs] <= key < a[hint - lastofs]
+    const int64_t maxofs = hint + 1;
+    while(ofs < maxofs && key < a[hint - ofs]) {
+      lastofs = ofs;
+      ofs = 2 * ofs + 1;
+    }
+    if(ofs > maxofs)
+      ofs = maxofs;
+
+    const int64_t k = lastofs;
+    lastofs = hint - ofs;
+    ofs = hint - k;
+
+  } else {
+
+// gallop right till a[hint + lastofs] <= key < a[hint + ofs]
+    const int64_t maxofs = n - hint;
+    while(ofs < maxofs && a[hint + ofs] <= key) {
+      lastofs = ofs;
+      ofs = 2 * ofs + 1;
+    }
+    if(ofs > maxofs)
+      ofs = maxofs;
+
+    lastofs += hint;
+    ofs += hint;
+
+  }
+
+  ++lastofs;
+  while(lastofs < ofs) {
+    const int64_t mid = lastofs + (ofs - lastofs) / 2;
+    if(key < a[mid]) {
+      ofs = mid;
+    } else {
+      lastofs = mid + 1;
+    }
+  }
+
+  return ofs;
+}
+
+// merges run a of na keys with run b of nb keys that follows it, na <= nb
+// a is copied to workspace and the merge goes left to right into the space of a and b
+// b[0] < a[0] and a[na-1] > b[nb-1] are known from mergeAt
+static void mergeLo(struct MergeState* ms, int64_t* a, uint64_t na, int64_t* b, uint64_t nb)
+{
+
+// copy of a is merged with b into the space where a was
+  memcpy(ms->tmp, a, na * sizeof(*a));
+
+  int64_t* dest = a;
+  int64_t* pa = ms->tmp;
+  int64_t* pb = b;
+
+  uint64_t min_gallop = ms->min_gallop;
+
+// b[0] is the smallest key of the two runs
+  *dest++ = *pb++;
+  --nb;
+
+  if(nb == 0)
+    goto succeed;
+  if(na == 1)
+    goto copy_b;
+
+  for(;;) {
+
+// number of keys in a row from a and from b
+    uint64_t acount = 0, bcount = 0;
+
+// one pair at a time mode till one run wins min_gallop times in a row
+    for(;;) {
+      if(*pb < *pa) {
+        *dest++ = *pb++;
+        ++bcount;
+        acount = 0;
+        --nb;
+        if(nb == 0)
+          goto succeed;
+        if(bcount >= min_gallop)
+          break;
+      } else {
+        *dest++ = *pa++;
+        ++acount;
+        bcount = 0;
+        --na;
+        if(na == 1)
+          goto copy_b;
+        if(acount >= min_gallop)
+          break;
+      }
+    }
+
+// gallop while stretches from one run are at least MIN_GALLOP long
+    ++min_gallop;
+
+    do {
+
+      min_gallop -= min_gallop > 1;
+      ms->min_gallop = min_gallop;
+
+// galloping mode, keys of a up to the next key of b
+      uint64_t k = gallopRight(*pb, pa, na, 0);
+      acount = k;
+      if(k > 0) {
+        memcpy(dest, pa, k * sizeof(*dest));
+        dest += k;
+        pa += k;
+        na -= k;
+        if(na == 1)
+          goto copy_b;
+        if(na == 0)
+          goto succeed;
+      }
+
+      *dest++ = *pb++;
+      --nb;
+      if(nb == 0)
+        goto succeed;
+
+// keys of b up to the next key of a
+      k = gallopLeft(*pa, pb, nb, 0);
+      bcount = k;
+      if(k > 0) {
+        memmove(dest, pb, k * sizeof(*dest));
+        dest += k;
+        pb += k;
+        nb -= k;
+        if(nb == 0)
+          goto succeed;
+      }
+
+      *dest++ = *pa++;
+      --na;
+      if(na == 1)
+        goto copy_b;
+
+    } while(acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+
+// leaving galloping costs a little more next time
+    ++min_gallop;
+    ms->min_gallop = min_gallop;
+  }
+
+succeed:
+  if(na > 0)
+    memcpy(dest, pa, na * sizeof(*dest));
+  return;
+
+// last key of a is the largest key of the two runs and goes after the rest of b
+copy_b:
+  memmove(dest, pb, nb * sizeof(*dest));
+  dest[nb] = *pa;
+}
+
+// merges run a of na keys with run b of nb keys that follows it, na > nb
+// b is copied to workspace and the merge goes right to left into the space of a and b
+static void mergeHi(struct MergeState* ms, int64_t* a, uint64_t na, int64_t* b, uint64_t nb)
+{
+
+// copy of b is merged with a into the space where b was from the right end
+  memcpy(ms->tmp, b, nb * sizeof(*b));
+
+  int64_t* dest = b + nb - 1;
+  int64_t* const basea = a;
+  int64_t* const baseb = ms->tmp;
+  int64_t* pa = a + na - 1;
+  int64_t* pb = ms->tmp + nb - 1;
+
+  uint64_t min_gallop = ms->min_gallop;
+
+// a[na-1] is the largest key of the two runs
+  *dest-- = *pa--;
+  --na;
+
+  if(na == 0)
+    goto succeed;
+  if(nb == 1)
+    goto copy_a;
+
+  for(;;) {
+
+    uint64_t acount = 0, bcount = 0;
+
+// one pair at a time mode till one run wins min_gallop times in a row
+    for(;;) {
+      if(*pb < *pa) {
+        *dest-- = *pa--;
+        ++acount;
+        bcount = 0;
+        --na;
+        if(na == 0)
+          goto succeed;
+        if(acount >= min_gallop)
+          break;
+      } else {
+        *dest-- = *pb--;
+        ++bcount;
+        acount = 0;
+        --nb;
+        if(nb == 1)
+          goto copy_a;
+        if(bcount >= min_gallop)
+          break;
+      }
+    }
+
+    ++min_gallop;
+
+    do {
+
+      min_gallop -= min_gallop > 1;
+      ms->min_gallop = min_gallop;
+
+// galloping mode, keys of a greater than the next key of b
+      uint64_t k = na - gallopRight(*pb, basea, na, na - 1);
+      acount = k;
+      if(k > 0) {
+        dest -= k;
+        pa -= k;
+        memmove(dest + 1, pa + 1, k * sizeof(*dest));
+        na -= k;
+        if(na == 0)
+          goto succeed;
+      }
+
+      *dest-- = *pb--;
+      --nb;
+      if(nb == 1)
+        goto copy_a;
+
+// keys of b at least as large as the next key of a
+      k = nb - gallopLeft(*pa, baseb, nb, nb - 1);
+      bcount = k;
+      if(k > 0) {
+        dest -= k;
+        pb -= k;
+        memcpy(dest + 1, pb + 1, k * sizeof(*dest));
+        nb -= k;
+        if(nb == 1)
+          goto copy_a;
+        if(nb == 0)
+          goto succeed;
+      }
+
+      *dest-- = *pa--;
+      --na;
+      if(na == 0)
+        goto succeed;
+
+    } while(acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+
+    ++min_gallop;
+    ms->min_gallop = min_gallop;
+  }
+
+succeed:
+  if(nb > 0)
+    memcpy(dest - (nb - 1), baseb, nb * sizeof(*dest));
+  return;
+
+// first key of b is the smallest key of the two runs and goes before the rest of a
+copy_a:
+  dest -= na;
+  pa -= na;
+  memmove(dest + 1, pa + 1, na * sizeof(*dest));
+  *dest = *pb;
+}
+
+// merges runs i and i + 1 of the stack into run i
+// merge_at of TimSort, one merge of two neighboring runs instead of a whole pass of Algorithm N
+static void mergeAt(struct MergeState* ms, const uint64_t i)
+{
+
+  int64_t* a = ms->run[i].a;
+  uint64_t na = ms->run[i].n;
+  int64_t* const b = ms->run[i + 1].a;
+  uint64_t nb = ms->run[i + 1].n;
+
+  ms->run[i].n = na + nb;
+
+// run i + 2 moves down to take the place of run i + 1
+  if(i + 3 == ms->runs) {
+    ms->run[i + 1] = ms->run[i + 2];
+  }
+  --ms->runs;
+
+// keys of a not greater than b[0] are already in place
+  const uint64_t k = gallopRight(b[0], a, na, 0);
+  a += k;
+  na -= k;
+
+  if(na == 0)
+    return;
+
+// keys of b not less than a[na-1] are already in place
+  nb = gallopLeft(a[na - 1], b, nb, nb - 1);
+
+  if(nb == 0)
+    return;
+
+  if(na <= nb) {
+    mergeLo(ms, a, na, b, nb);
+  } else {
+    mergeHi(ms, a, na, b, nb);
+  }
+}
+
+// merges runs on top of the stack till the invariants hold
+// len[k-2] > len[k-1] + len[k] and len[k-1] > len[k] for the top of the stack and one run below
+static void mergeCollapse(struct MergeState* ms)
+{
+
+  struct Run* const run = ms->run;
+
+  while(ms->runs > 1) {
+
+    uint64_t k = ms->runs - 2;
+
+    if((k > 0 && run[k - 1].n <= run[k].n + run[k + 1].n) || (k > 1 && run[k - 2].n <= run[k - 1].n + run[k].n)) {
+      if(run[k - 1].n < run[k + 1].n)
+        --k;
+      mergeAt(ms, k);
+    } else if(run[k].n <= run[k + 1].n) {
+      mergeAt(ms, k);
+    } else {
+      break;
+    }
+  }
+}
+
+// merges all runs left on the stack
+static void mergeForceCollapse(struct MergeState* ms)
+{
+
+  struct Run* const run = ms->run;
+
+  while(ms->runs > 1) {
+
+    uint64_t k = ms->runs - 2;
+
+    if(k > 0 && run[k - 1].n < run[k + 1].n)
+      --k;
+    mergeAt(ms, k);
+  }
+}
+
+// Sort takes array K of N elements beginning at K[1]
+// Sort implements Algorithm N (Natural two-way merge sort) with minimum run length, run stack and galloping merge
+// K is sorted in place, K[N+1],...,K[N+N/2] is workspace
+void Sort(const uint64_t N; int64_t K[N + N/2 + 1], const uint64_t N)
+{
+
+  if(N < 2)
+    return;
+
+  struct MergeState ms = {.runs = 0, .tmp = &K[N + 1], .min_gallop = MIN_GALLOP};
+
+  const uint64_t minrun = minRun(N);
+
+// keys K[i],...,K[N] are not yet in a run
+  for(uint64_t i = 1; i <= N;) {
+
+    const uint64_t left = N - i + 1;
+
+// natural run as in N3-N12, reversed if it descends
+    uint64_t n = countRun(&K[i], left);
+
+// short run is extended to minrun keys, or to the end of the array
+    if(n < minrun) {
+      const uint64_t force = left < minrun ? left : minrun;
+      binaryInsertion(&K[i], force, n);
+      n = force;
+    }
+
+    ms.run[ms.runs++] = (struct Run){&K[i], n};
+    mergeCollapse(&ms);
+
+    i += n;
+  }
+
+// runs left on the stack are merged till one is left, as Algorithm N makes passes till a pass leaves one run
+  mergeForceCollapse(&ms);
+
+}
+
+int main(int argc, char* argv[])
+{
+
+  (void)argv;
+
+  if(argc > 1) {
+    usage();
+    exit(0);
+  }
+
+// read 64-bit size of data array as binary data
+  uint64_t N;
+  fread(&N, sizeof N, 1, stdin);
+
+// array of records is too big for the stack when N is large
+// allocate N+1 entries to use array indexing from 1 instead of 0
+// plus extra N/2 entries for merge workspace
+  int64_t* R = malloc((N + N/2 + 1) * sizeof(*R));
+
+  if(R == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+// read array R of records as binary data
+  fread(&R[1], sizeof(*R), N, stdin);
+
+  Sort(R, N);
+
+// write number of values to follow
+  fwrite(&N, sizeof N, 1, stdout);
+
+// print sorted array as binary data
+  fwrite(&R[1], sizeof(*R), N, stdout);
+
+  free(R);
+
+  return 0;
+}
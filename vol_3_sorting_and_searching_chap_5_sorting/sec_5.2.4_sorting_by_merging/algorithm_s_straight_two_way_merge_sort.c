@@ -4,11 +4,22 @@
 // 5.2.4 Sorting by Merging
 // The Art of Computer Programming, Donald Knuth
 
+#include "algorithm_m_two_way_merge.h"
+#include "merge_in_place.h"
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <threads.h>
+
+// L2 cache size in bytes if sysconf does not know it
+#define L2_CACHE_SIZE (UINT64_C(256) << 10)
+
+// most threads for -t
+#define THREADS_MAX 1024
 
 // very similar to algorithm n natural two-way merge sort
 // runs here are determined artificially using the fact that merging two
@@ -26,7 +37,7 @@
 
 static void usage()
 {
-  puts("usage:algorithm_s_straight_two_way_merge_sort <in.dat >out.dat");
+  puts("usage:algorithm_s_straight_two_way_merge_sort [-v | -b | -i | -c [-4] [-B keys] | -t threads] <in.dat >out.dat");
   puts("Implements Algorithm S (Straight two-way merge sort), 5.2.4 Sorting by Merging, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
 
   puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
@@ -44,9 +55,23 @@ static void usage()
   puts("uint64_t N");
   puts("int64_t[N] sorted data");
 
+  puts("");
+  puts("-v: merge passes go left to right with the SIMD bitonic merge kernel of Algorithm M");
+  puts("-b: merge passes go left to right in place with workspace for N/2 keys instead of N");
+  puts("-i: merge passes go left to right in place by blocks with workspace for about sqrt(N) keys");
+  puts("-c: blocks that fit in L2 cache with their workspace are sorted first, then merged with passes over the whole array");
+  puts("-4: like -c but passes over the whole array merge 4 runs at a time");
+  puts("-B: number of keys in a block of -c and -4, default is as many as fill L2 cache with their workspace");
+  puts("-t: merge passes go left to right with the output of each pass split evenly over this many threads, 1 to 1024");
+
   puts("");
   puts("examples:");
   puts("algorithm_s_straight_two_way_merge_sort <data/algorithm_s_straight_two_way_merge_sort/in.0.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_s_straight_two_way_merge_sort -v <data/algorithm_s_straight_two_way_merge_sort/in.7.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_s_straight_two_way_merge_sort -b <data/algorithm_s_straight_two_way_merge_sort/in.8.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_s_straight_two_way_merge_sort -i <data/algorithm_s_straight_two_way_merge_sort/in.9.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_s_straight_two_way_merge_sort -c -B 64 <data/algorithm_s_straight_two_way_merge_sort/in.10.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_s_straight_two_way_merge_sort -4 -B 64 <data/algorithm_s_straight_two_way_merge_sort/in.11.le.dat | od -An -td8 -w8 -v");
 }
 
 // Sort takes array K of N elements beginning at K[1]
@@ -254,27 +279,410 @@ void Sort(const uint64_t N; int64_t K[2*N + 1], const uint64_t N)
 
 }
 
+// SortSimd takes array K of N elements beginning at K[1]
+// SortSimd merges runs of length p = 1, 2, 4, ... like Algorithm S but each pass merges adjacent pairs of runs left to right
+// so every merge is a call to merge_simd of Algorithm M instead of steps S3-S11
+// the second half of K is the workspace as in Algorithm S
+// K is sorted in place
+void SortSimd(const uint64_t N; int64_t K[2*N + 1], const uint64_t N)
+{
+
+// source and destination areas, both indexed from 1
+  int64_t* src = K;
+  int64_t* dst = &K[N];
+
+  for(uint64_t p = 1; p < N; p += p) {
+
+    for(uint64_t i = 1; i <= N; i += 2 * p) {
+
+// runs are src_i,...,src_(i+m-1) and src_(i+m),...,src_(i+m+n-1), shorter at end of area
+      const uint64_t m = N - i + 1 < p ? N - i + 1 : p;
+      const uint64_t n = N - i + 1 - m < p ? N - i + 1 - m : p;
+
+// pointers are offset so runs are indexed from 1
+      merge_simd(&src[i - 1], m, &src[i - 1 + m], n, &dst[i - 1]);
+    }
+
+// switch areas
+    int64_t* tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+// copy workspace to original array if it holds the sorted output
+  if(src != K) {
+    memcpy(&K[1], &src[1], N * sizeof(*K));
+  }
+
+}
+
+// SortInPlace takes array K of N elements beginning at K[1]
+// SortInPlace merges runs of length p = 1, 2, 4, ... like Algorithm S but each pass merges adjacent pairs of runs left to right
+// in place with merge_in_place so there is no second area of N keys
+// W is workspace for s keys and TAG for N / s + 1 block numbers
+// K is sorted in place
+void SortInPlace(const uint64_t N; int64_t K[N + 1], const uint64_t N, int64_t W[], const uint64_t s, uint64_t TAG[])
+{
+
+  for(uint64_t p = 1; p < N; p += p) {
+
+    for(uint64_t i = 1; i + p <= N; i += 2 * p) {
+
+// runs are K_i,...,K_(i+p-1) and K_(i+p),...,K_(i+p+n-1), second one shorter at end of array
+      const uint64_t n = N - i + 1 - p < p ? N - i + 1 - p : p;
+
+// pointer is offset so runs are indexed from 1
+      merge_in_place(&K[i - 1], p, n, W, s, TAG);
+    }
+
+  }
+
+}
+
+// mergeMultiway merges r runs x[0],...,x[r-1] of n[0],...,n[r-1] keys into z, all indexed from 1
+// runs are not empty, equal keys of an earlier run come first
+// the smallest of the first keys of the runs is output till only two runs are left for merge of Algorithm M
+static void mergeMultiway(uint64_t r, int64_t* x[], uint64_t n[], int64_t z[])
+{
+
+  uint64_t i[r];
+  for(uint64_t t = 0; t < r; ++t) {
+    i[t] = 1;
+  }
+
+  uint64_t k = 1;
+
+  while(r > 2) {
+
+    uint64_t w = 0;
+    for(uint64_t t = 1; t < r; ++t) {
+      if(x[t][i[t]] < x[w][i[w]])
+        w = t;
+    }
+
+    z[k++] = x[w][i[w]++];
+
+// run w is used up
+    if(i[w] > n[w]) {
+      for(uint64_t t = w + 1; t < r; ++t) {
+        x[t - 1] = x[t];
+        n[t - 1] = n[t];
+        i[t - 1] = i[t];
+      }
+      --r;
+    }
+  }
+
+// pointers are offset so the rest of each run is indexed from 1
+  if(r == 2) {
+    merge(&x[0][i[0] - 1], n[0] - i[0] + 1, &x[1][i[1] - 1], n[1] - i[1] + 1, &z[k - 1]);
+  } else {
+    memcpy(&z[k], &x[0][i[0]], (n[0] - i[0] + 1) * sizeof(*z));
+  }
+}
+
+// SortCache takes array K of N elements beginning at K[1]
+// Algorithm S makes lg N passes over all 2N keys, each of them goes out to memory once N keys do not fit in the cache
+// SortCache first sorts blocks of B keys one at a time with passes like Algorithm S
+// a block and its part of the workspace are small enough to stay in the cache for all lg B passes on the block
+// only the lg(N/B) passes that merge sorted blocks go out to memory, or log4(N/B) when ways = 4
+// passes go left to right and merge with merge of Algorithm M, the second half of K is the workspace as in Algorithm S
+// K is sorted in place
+void SortCache(const uint64_t N; int64_t K[2*N + 1], const uint64_t N, const uint64_t B, const uint64_t ways)
+{
+
+// sort each block with its own part of the workspace
+  for(uint64_t b = 1; b <= N; b += B) {
+
+    const uint64_t length = N - b + 1 < B ? N - b + 1 : B;
+
+// source and destination areas of block, both indexed from 1
+    int64_t* src = &K[b - 1];
+    int64_t* dst = &K[N + b - 1];
+
+    for(uint64_t p = 1; p < length; p += p) {
+
+      for(uint64_t i = 1; i <= length; i += 2 * p) {
+        const uint64_t m = length - i + 1 < p ? length - i + 1 : p;
+        const uint64_t n = length - i + 1 - m < p ? length - i + 1 - m : p;
+        merge(&src[i - 1], m, &src[i - 1 + m], n, &dst[i - 1]);
+      }
+
+      int64_t* tmp = src;
+      src = dst;
+      dst = tmp;
+    }
+
+// sorted block goes back to K, this copy stays in the cache too
+    if(src != &K[b - 1]) {
+      memcpy(&K[b], &src[1], length * sizeof(*K));
+    }
+  }
+
+// passes over the whole array merge runs of B, ways * B, ... keys
+  int64_t* src = K;
+  int64_t* dst = &K[N];
+
+  for(uint64_t p = B; p < N; p *= ways) {
+
+    for(uint64_t i = 1; i <= N; i += ways * p) {
+
+// up to ways runs starting at src_i, shorter at end of area
+      int64_t* x[ways];
+      uint64_t n[ways];
+      uint64_t r = 0;
+
+      for(uint64_t j = i; j <= N && r < ways; j += p) {
+        x[r] = &src[j - 1];
+        n[r] = N - j + 1 < p ? N - j + 1 : p;
+        ++r;
+      }
+
+      mergeMultiway(r, x, n, &dst[i - 1]);
+    }
+
+// switch areas
+    int64_t* tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+// copy workspace to original array if it holds the sorted output
+  if(src != K) {
+    memcpy(&K[1], &src[1], N * sizeof(*K));
+  }
+
+}
+
+// part of one pass of SortParallel merged by one thread
+struct Part {
+// source and destination areas, both indexed from 1
+  int64_t* src;
+  int64_t* dst;
+  uint64_t N;
+// run length of the pass
+  uint64_t p;
+// part is dst_first,...,dst_last
+  uint64_t first;
+  uint64_t last;
+};
+
+// merges the keys that go to dst_first,...,dst_last in a pass with run length p
+// pairs of runs that lie inside the part are merged whole
+// a pair cut by the start or end of the part is merged only from the cut on or up to it
+// corank of Algorithm M finds how many keys of each run come before the cut
+static int mergePart(void* arg)
+{
+
+  const struct Part* part = arg;
+
+  int64_t* const src = part->src;
+  int64_t* const dst = part->dst;
+  const uint64_t N = part->N;
+  const uint64_t p = part->p;
+
+// first pair that reaches into the part
+  const uint64_t start = (part->first - 1) / (2 * p) * (2 * p) + 1;
+
+  for(uint64_t i = start; i <= part->last; i += 2 * p) {
+
+// runs are x_1,...,x_m and y_1,...,y_n, merged into z
+    const uint64_t m = N - i + 1 < p ? N - i + 1 : p;
+    const uint64_t n = N - i + 1 - m < p ? N - i + 1 - m : p;
+    int64_t* const x = &src[i - 1];
+    int64_t* const y = &src[i - 1 + m];
+    int64_t* const z = &dst[i - 1];
+
+// this part outputs z_(lo+1),...,z_hi of the pair
+    const uint64_t lo = part->first > i ? part->first - i : 0;
+    const uint64_t hi = part->last < i + m + n - 1 ? part->last - i + 1 : m + n;
+
+// keys of x before each cut
+    const uint64_t a = lo == 0 ? 0 : corank(x, m, y, n, lo);
+    const uint64_t b = hi == m + n ? m : corank(x, m, y, n, hi);
+
+// pointers are offset so each piece is indexed from 1
+    merge(&x[a], b - a, &y[lo - a], (hi - b) - (lo - a), &z[lo]);
+  }
+
+  return 0;
+}
+
+// SortParallel takes array K of N elements beginning at K[1]
+// SortParallel merges runs of length p = 1, 2, 4, ... like Algorithm S with passes that go left to right
+// the N keys output by a pass are split into T parts of nearly equal size, one for each thread
+// in early passes a part holds many pairs of runs and only the pairs at its ends are cut
+// in the last passes there are fewer pairs than threads and each merge is cut into several parts by corank
+// every key goes to the same place as in a serial merge so the output is identical
+// the second half of K is the workspace as in Algorithm S
+// K is sorted in place
+void SortParallel(const uint64_t N; int64_t K[2*N + 1], const uint64_t N, uint64_t T)
+{
+
+  if(T > N)
+    T = N > 0 ? N : 1;
+
+  int64_t* src = K;
+  int64_t* dst = &K[N];
+
+  struct Part* const part = malloc(T * sizeof *part);
+  thrd_t* const thread = malloc(T * sizeof *thread);
+  if(part == NULL || thread == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  for(uint64_t p = 1; p < N; p += p) {
+
+    for(uint64_t t = 0; t < T; ++t) {
+      part[t] = (struct Part){src, dst, N, p, N / T * t + N % T * t / T + 1, N / T * (t + 1) + N % T * (t + 1) / T};
+    }
+
+// part 0 is merged by the calling thread
+    for(uint64_t t = 1; t < T; ++t) {
+      if(thrd_create(&thread[t], mergePart, &part[t]) != thrd_success) {
+        fprintf(stderr, "error: thrd_create failure\n");
+        exit(2);
+      }
+    }
+
+    mergePart(&part[0]);
+
+    for(uint64_t t = 1; t < T; ++t) {
+      thrd_join(thread[t], NULL);
+    }
+
+// switch areas
+    int64_t* tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  free(thread);
+  free(part);
+
+// copy workspace to original array if it holds the sorted output
+  if(src != K) {
+    memcpy(&K[1], &src[1], N * sizeof(*K));
+  }
+
+}
+
 int main(int argc, char* argv[])
 {
 
-  (void)argv;
+// merge passes, 'v' for SIMD kernel, 'b' for N/2 workspace, 'i' for in place by blocks,
+// 'c' for cache blocks, '4' for cache blocks with 4-way merge, 't' for threads, 0 for Algorithm S
+  int mode = 0;
 
-  if(argc > 1) {
+// number of threads
+  uint64_t T = 1;
+
+// keys in a cache block, 0 to fill L2 cache
+  uint64_t B = 0;
+
+  for(int opt; (opt = getopt(argc, argv, "4B:bchit:v")) != -1;) {
+    switch(opt) {
+      case 'B':
+        B = strtoull(optarg, NULL, 10);
+        if(B == 0) {
+          usage();
+          exit(1);
+        }
+        break;
+      case 'c':
+      case '4':
+// -4 goes with -c
+        if(mode != 0 && mode != 'c' && mode != '4') {
+          usage();
+          exit(1);
+        }
+        if(mode != '4')
+          mode = opt;
+        break;
+      case 't':
+        T = strtoull(optarg, NULL, 10);
+// fall through
+      case 'b':
+      case 'i':
+      case 'v':
+        if(mode != 0 && mode != opt) {
+          usage();
+          exit(1);
+        }
+        mode = opt;
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind < argc || T == 0 || T > THREADS_MAX || (B != 0 && mode != 'c' && mode != '4')) {
     usage();
-    exit(0);
+    exit(1);
   }
 
 // read 64-bit size of data array as binary data
   uint64_t N;
   fread(&N, sizeof N, 1, stdin);
 
-// read array R of records as binary data
+// keys in workspace W for merging in place
+  uint64_t s = 0;
+
+  if(mode == 'b') {
+    s = N / 2;
+  } else if(mode == 'i') {
+// s is ceiling of sqrt(N)
+    while(s * s < N) {
+      ++s;
+    }
+  }
+
+  if(s == 0) {
+    s = 1;
+  }
+
+// array of records is too big for the stack when N is large
 // allocate N+1 entries to use array indexing from 1 instead of 0
-// plus extra N entries for merge workspace
-  int64_t R[2*N + 1];
+// plus extra N entries for merge workspace unless merging in place
+  const bool inPlace = mode == 'b' || mode == 'i';
+  int64_t* R = malloc((inPlace ? N + 1 : 2*N + 1) * sizeof(*R));
+  int64_t* W = NULL;
+  uint64_t* TAG = NULL;
+
+  if(inPlace) {
+    W = malloc((s + 1) * sizeof(*W));
+    TAG = malloc((N / s + 1) * sizeof(*TAG));
+  }
+
+  if(R == NULL || (inPlace && (W == NULL || TAG == NULL))) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+// read array R of records as binary data
   fread(&R[1], sizeof(*R), N, stdin);
 
-  Sort(R, N);
+  if(mode == 'v') {
+    SortSimd(R, N);
+  } else if(mode == 't') {
+    SortParallel(R, N, T);
+  } else if(mode == 'c' || mode == '4') {
+// block and its workspace fill L2 cache
+    if(B == 0) {
+      const long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+      B = (l2 > 0 ? (uint64_t)l2 : L2_CACHE_SIZE) / (2 * sizeof(*R));
+    }
+    SortCache(R, N, B, mode == '4' ? 4 : 2);
+  } else if(inPlace) {
+    SortInPlace(R, N, W, s, TAG);
+  } else {
+    Sort(R, N);
+  }
 
 // write number of values to follow
   fwrite(&N, sizeof N, 1, stdout);
@@ -282,6 +690,10 @@ int main(int argc, char* argv[])
 // print sorted array as binary data
   fwrite(&R[1], sizeof(*R), N, stdout);
 
+  free(TAG);
+  free(W);
+  free(R);
+
   return 0;
 }
 
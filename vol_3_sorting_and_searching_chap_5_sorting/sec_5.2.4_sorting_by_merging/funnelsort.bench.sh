@@ -0,0 +1,92 @@
+#!/bin/bash
+
+# funnelsort.bench.sh
+
+# benchmark for funnelsort.c against Algorithms N and S
+# usage: funnelsort.bench.sh [-n "N ..."] [-d dir]
+
+function usage {
+  echo "usage: funnelsort.bench.sh [-n \"N ...\"] [-d dir]"
+  echo "sorts N random 64-bit keys with funnelsort and Algorithms N and S for each N given"
+  echo "prints elapsed time, throughput and cache misses counted by perf if it is installed"
+  echo "-n: numbers of keys, default is \"1000000 10000000 100000000\""
+  echo "-d: directory of the programs, default is from PATH"
+}
+
+while getopts "d:hn:" opt; do
+  case $opt in
+    d) dir=$OPTARG/;;
+    h) usage; exit 0;;
+    n) ns=$OPTARG;;
+    *) usage; exit 1
+  esac
+done
+shift $((OPTIND-1))
+
+: ${ns:="1000000 10000000 100000000"} ${dir:=}
+
+programs=(funnelsort algorithm_n_natural_two_way_merge_sort algorithm_s_straight_two_way_merge_sort)
+
+set -o pipefail
+
+# input goes in a temporary file that is removed on exit, also when interrupted
+infile=$(mktemp) || exit 1
+trap 'rm -f "$infile"' EXIT
+
+# binary input is N and N random keys
+function le64 {
+  local hex
+  printf -vhex "%.16x" $1
+  for((j=14; j >= 0; j-=2)); do
+    printf "\x${hex:j:2}"
+  done
+}
+
+if command -v perf >/dev/null; then
+  perf=true
+else
+  perf=false
+  echo "perf not found, cache misses not counted"
+fi
+
+echo "bench pid $$ funnelsort N $ns"
+
+printf "%-12s %-40s %10s %12s %16s %16s\n" N program seconds Mkeys/s cache-misses LLC-load-misses
+
+for n in $ns; do
+
+  {
+    le64 $n
+    head -c $((8 * n)) /dev/urandom
+  } > "$infile"
+
+  for program in "${programs[@]}"; do
+
+    start=$(date +%s%N)
+
+    if $perf; then
+      counts=$(perf stat -x, -e cache-misses,LLC-load-misses $dir$program <"$infile" 2>&1 >/dev/null | cut -d, -f1 | paste -sd' ')
+      es=$?
+    else
+      $dir$program <"$infile" >/dev/null
+      es=$?
+      counts="- -"
+    fi
+
+    end=$(date +%s%N)
+
+    if ((es)); then
+      echo "bench run $program N $n es $es"
+      exit $es
+    fi
+
+    read misses llc <<<"$counts"
+
+# elapsed time in milliseconds and throughput in thousands of keys per second
+    ((ms = (end - start) / 1000000, ms = ms > 0 ? ms : 1))
+    ((kps = n / ms))
+    printf "%-12s %-40s %6d.%03d %8d.%03d %16s %16s\n" $n $program $((ms/1000)) $((ms%1000)) $((kps/1000)) $((kps%1000)) $misses $llc
+
+  done
+
+done
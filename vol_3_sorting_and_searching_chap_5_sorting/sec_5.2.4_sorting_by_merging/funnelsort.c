@@ -0,0 +1,355 @@
+// funnelsort.c
+
+// Lazy funnelsort, a cache-oblivious merge sort
+// 5.2.4 Sorting by Merging
+// The Art of Computer Programming, Donald Knuth
+// Cache-Oblivious Algorithms, Frigo, Leiserson, Prokop and Ramachandran, 1999
+// Cache Oblivious Distribution Sweeping, Brodal and Fagerberg, 2002
+
+#include "../sec_5.2.1_sorting_by_insertion/algorithm_s_straight_insertion_sort.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+// Algorithms N and S merge two runs at a time and make lg N passes over all the keys
+// once the keys are much larger than a cache every pass misses on every block of keys
+// funnelsort merges k = N^(1/3) sorted runs of N^(2/3) keys at a time with a k-funnel
+// and sorts each run the same way, which gives O((N/B) log_M N) cache misses
+// for every cache size M and block size B at once, the lowest possible for sorting by comparisons
+// nothing in the program depends on M or B so there is no tuning for a machine with several levels of cache
+
+// a k-funnel is a complete binary tree of two-way mergers with k inputs
+// the tree of height h is cut at half its height into a top tree and 2^(h/2) bottom trees
+// the bottom trees feed the leaves of the top tree through buffers of (2^h)^(3/2) keys
+// and the top tree and each bottom tree are cut the same way, down to single mergers
+// buffers are laid out in memory in this recursive order so that any subtree that fits in a cache
+// lies in about as many blocks as its size needs
+// all buffers of a k-funnel hold O(k^2) = O(N^(2/3)) keys
+
+// a merger is filled lazily, only when its parent finds its buffer empty
+// fill merges from the buffers of its two children till its own buffer is full or both children are used up
+// and fills a child first whenever the buffer of the child runs empty
+// the root merger writes straight into the output
+
+// runs of at most BASE keys are sorted by one of the insertion sorts of 5.2.1, straight insertion unless -i chooses another
+
+#define BASE 16
+
+static void usage()
+{
+  puts("usage:funnelsort [-i straight | binary | two-way] <in.dat >out.dat");
+  puts("Implements lazy funnelsort, a cache-oblivious merge sort, with the two-way merging of 5.2.4 Sorting by Merging, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
+
+  puts("");
+  puts("-i: insertion for runs of at most 16 keys, default is straight");
+
+  puts("first uint64_t is number of values to sort");
+  puts("next that many int64_t is data to sort");
+
+  puts("");
+  puts("binary input data format");
+  puts("uint64_t N");
+  puts("int64_t[N] data");
+
+  puts("");
+  puts("binary output data format");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("examples:");
+  puts("funnelsort <data/funnelsort/in.0.le.dat | od -An -td8 -w8 -v");
+  puts("funnelsort -i binary <data/funnelsort/in.0.le.dat | od -An -td8 -w8 -v");
+  puts("funnelsort.bench.sh -n 100000000 -d build");
+}
+
+// buffer of a merger or an input run of the funnel, keys buf[head],...,buf[tail - 1] are waiting
+struct Node {
+  int64_t* buf;
+  uint64_t cap;
+  uint64_t head;
+  uint64_t tail;
+// no more keys will come into the buffer
+  bool done;
+};
+
+// funnel with k inputs, mergers are node[1],...,node[k - 1] and inputs are node[k],...,node[2k - 1]
+// children of node[v] are node[2v] and node[2v + 1], node[1] is the root
+struct Funnel {
+  uint64_t k;
+  struct Node* node;
+// buffers are carved from space in recursive layout order
+  int64_t* space;
+  uint64_t used;
+};
+
+// keys in the buffer below the root of a tree of height h, ceiling of 2^(3h/2)
+static uint64_t bufferSize(const unsigned h)
+{
+
+  const uint64_t n = UINT64_C(1) << (h + h / 2);
+
+  return h % 2 == 0 ? n : (n * 1414213563 + 999999999) / 1000000000;
+}
+
+// height h of the funnel for n keys, smallest h with k = 2^h and k^3 >= n
+static unsigned height(const uint64_t n)
+{
+  unsigned h = 1;
+  while(h < 21 && (UINT64_C(1) << (3 * h)) < n) {
+    ++h;
+  }
+  return h;
+}
+
+// total keys in the buffers inside a tree of height h
+static uint64_t funnelSpace(const unsigned h)
+{
+
+  if(h <= 1)
+    return 0;
+
+  const unsigned top = h / 2;
+  const unsigned bottom = h - top;
+
+  return funnelSpace(top) + (UINT64_C(1) << top) * (bufferSize(h) + funnelSpace(bottom));
+}
+
+// lays out the buffers of the tree of height h with root v
+// the buffers below the leaves of the top tree come before the bottom tree each of them feeds
+static void layout(struct Funnel* f, const uint64_t v, const unsigned h)
+{
+
+  if(h <= 1)
+    return;
+
+  const unsigned top = h / 2;
+  const unsigned bottom = h - top;
+
+  layout(f, v, top);
+
+// roots of the bottom trees are 2^top levels below v
+  const uint64_t first = v << top;
+  const uint64_t size = bufferSize(h);
+
+  for(uint64_t b = first; b < first + (UINT64_C(1) << top); ++b) {
+    f->node[b] = (struct Node){&f->space[f->used], size, 0, 0, false};
+    f->used += size;
+    layout(f, b, bottom);
+  }
+}
+
+// fills buffer of merger v from its two children
+static void fill(struct Funnel* f, const uint64_t v)
+{
+
+  struct Node* const z = &f->node[v];
+  struct Node* const x = &f->node[2 * v];
+  struct Node* const y = &f->node[2 * v + 1];
+
+  const bool leaves = 2 * v >= f->k;
+
+  z->head = z->tail = 0;
+
+  while(z->tail < z->cap) {
+
+// a child is filled only when its buffer runs empty
+    if(x->head == x->tail && !x->done && !leaves)
+      fill(f, 2 * v);
+    if(y->head == y->tail && !y->done && !leaves)
+      fill(f, 2 * v + 1);
+
+    const uint64_t xn = x->tail - x->head;
+    const uint64_t yn = y->tail - y->head;
+    const uint64_t space = z->cap - z->tail;
+
+    if(xn == 0 && yn == 0) {
+      z->done = true;
+      break;
+    }
+
+    if(xn == 0 || yn == 0) {
+// transmit rest of the other child as far as it goes, as in steps M4 and M6
+      struct Node* const w = xn == 0 ? y : x;
+      const uint64_t n = (xn == 0 ? yn : xn) < space ? (xn == 0 ? yn : xn) : space;
+      memcpy(&z->buf[z->tail], &w->buf[w->head], n * sizeof(*z->buf));
+      w->head += n;
+      z->tail += n;
+      continue;
+    }
+
+// steps M2, M3 and M5 of Algorithm M run unchecked till one of the three buffers needs attention
+    uint64_t steps = space;
+    if(xn < steps)
+      steps = xn;
+    if(yn < steps)
+      steps = yn;
+
+    const int64_t* const X = x->buf;
+    const int64_t* const Y = y->buf;
+    int64_t* const Z = z->buf;
+
+    uint64_t i = x->head, j = y->head, l = z->tail;
+
+// the smaller key is selected without a branch, the outcome of X_i <= Y_j is random on random keys
+    for(; steps > 0; --steps) {
+      const int64_t a = X[i];
+      const int64_t b = Y[j];
+      const bool left = a <= b;
+      Z[l++] = left ? a : b;
+      i += left;
+      j += !left;
+    }
+
+    x->head = i;
+    y->head = j;
+    z->tail = l;
+  }
+}
+
+// sorts K_1,...,K_n of a run with kernel
+static void insertion(int64_t K[], const uint64_t n, const enum Insertion kernel)
+{
+// workspace for two-way insertion
+  int64_t X[2 * BASE];
+  insertion_sort(n, K, X, kernel);
+}
+
+// sorts K_1,...,K_n with W_1,...,W_n as workspace, sorted keys end up in W when swap is true
+// the runs are sorted into the other array so the funnel merges them into place without copying
+// f has room for the funnel of the top level of the sort
+static void funnelsort(int64_t K[], int64_t W[], const uint64_t n, const bool swap, struct Funnel* f, const enum Insertion kernel)
+{
+
+  if(n <= BASE) {
+    insertion(K, n, kernel);
+    if(swap)
+      memcpy(&W[1], &K[1], n * sizeof(*W));
+    return;
+  }
+
+// k = 2^h >= n^(1/3) runs of about n/k keys
+  const unsigned h = height(n);
+  const uint64_t k = UINT64_C(1) << h;
+  const uint64_t size = (n + k - 1) / k;
+
+  for(uint64_t r = 0; r * size < n; ++r) {
+    const uint64_t m = n - r * size < size ? n - r * size : size;
+    funnelsort(&K[r * size], &W[r * size], m, !swap, f, kernel);
+  }
+
+  int64_t* const from = swap ? K : W;
+  int64_t* const to = swap ? W : K;
+
+// runs are the inputs of the funnel, inputs past the end of the keys are empty
+  f->k = k;
+  f->used = 0;
+
+  for(uint64_t r = 0; r < k; ++r) {
+    const uint64_t start = r * size < n ? r * size : n;
+    const uint64_t m = n - start < size ? n - start : size;
+    f->node[k + r] = (struct Node){&from[start + 1], m, 0, m, true};
+  }
+
+// the root writes straight into the output
+  f->node[1] = (struct Node){&to[1], n, 0, 0, false};
+
+  layout(f, 1, h);
+
+  fill(f, 1);
+}
+
+// Sort takes array K of N keys beginning at K[1] and workspace W of N keys beginning at W[1]
+// runs of at most BASE keys are sorted with kernel
+// K is sorted in place
+void Sort(const uint64_t N; int64_t K[N + 1], int64_t W[N + 1], const uint64_t N, const enum Insertion kernel)
+{
+
+  if(N <= BASE) {
+    insertion(K, N, kernel);
+    return;
+  }
+
+// room for the funnel of the top level, the funnels of all smaller levels are no larger
+  const unsigned h = height(N);
+
+  struct Funnel f;
+  f.node = malloc((UINT64_C(2) << h) * sizeof(*f.node));
+  f.space = malloc(funnelSpace(h) * sizeof(*f.space));
+
+  if(f.node == NULL || (f.space == NULL && funnelSpace(h) > 0)) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  funnelsort(K, W, N, false, &f, kernel);
+
+  free(f.space);
+  free(f.node);
+}
+
+int main(int argc, char* argv[])
+{
+
+  enum Insertion kernel = INSERTION_STRAIGHT;
+
+  for(int opt; (opt = getopt(argc, argv, "hi:")) != -1;) {
+    switch(opt) {
+      case 'h':
+        usage();
+        exit(0);
+      case 'i':
+        kernel = insertion_kernel(optarg);
+        if(kernel == INSERTION_COUNT) {
+          fprintf(stderr, "Invalid input data: -i must be straight, binary or two-way\n");
+          usage();
+          exit(1);
+        }
+        break;
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind < argc) {
+    usage();
+    exit(0);
+  }
+
+// read 64-bit size of data array as binary data
+  uint64_t N;
+  fread(&N, sizeof N, 1, stdin);
+
+// arrays are too big for the stack when sorting large inputs
+// allocate N+1 entries to use array indexing from 1 instead of 0
+  int64_t* K = malloc((N + 1) * sizeof(*K));
+  int64_t* W = malloc((N + 1) * sizeof(*W));
+
+  if(K == NULL || W == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+// read array K of keys as binary data
+  fread(&K[1], sizeof(*K), N, stdin);
+
+  Sort(K, W, N, kernel);
+
+// write number of values to follow
+  fwrite(&N, sizeof N, 1, stdout);
+
+// print sorted array as binary data
+  fwrite(&K[1], sizeof(*K), N, stdout);
+
+  free(W);
+  free(K);
+
+  return 0;
+}
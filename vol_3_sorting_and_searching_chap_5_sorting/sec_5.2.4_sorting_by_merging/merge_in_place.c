@@ -0,0 +1,208 @@
+// merge_in_place.c
+
+// Stable merging of adjacent runs with little workspace
+// 5.2.4 Sorting by Merging
+// The Art of Computer Programming, Donald Knuth
+
+#include "merge_in_place.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+// Algorithms N and S merge from an area of N keys into another area of N keys
+// here two runs next to each other in one area are merged into the same place
+
+// when the shorter run has at most s keys it is copied to W
+// and merged into the space of both runs from the end it shares with the longer run
+// with s = N/2 this always happens since the shorter of two runs in N keys has at most N/2 keys
+
+// otherwise the runs are merged by blocks of s keys, as in the in-place merging of 5.2.4 with about sqrt(N) blocks
+// the first run A is cut into a fragment of m mod s keys followed by whole blocks
+// the second run B is cut into whole blocks followed by a fragment of n mod s keys
+// whole blocks are sorted by selection on their first key, ties go to blocks of A and then to the original block number
+// so blocks of A stay in their original order and blocks of B stay in their original order
+// TAG remembers the original block number of each block
+// one pass over the blocks then merges each block with at most s keys left over before it
+// the keys left over all come from one run and lie just before the block
+// if the block comes from the same run as the leftover keys they are in their final place
+// since every key still to come is at least the first key of the block
+// otherwise the leftover keys are copied to W and merged with the block till one of them runs out
+// the rest of whichever runs out last becomes the new leftover
+// the fragment of A starts out as the leftover, the fragment of B is merged in at the end through W
+// selection moves about m + n keys and makes about ((m + n) / s)^2 comparisons of blocks
+// and the pass over the blocks moves about 2(m + n) keys, so merging is still linear for s near sqrt(m + n)
+
+// merges a_1,...,a_m with b_1,...,b_n that follows it in memory, m <= s
+// a is copied to W and the merge goes left to right
+static void mergeLow(int64_t a[], const uint64_t m, const uint64_t n, int64_t W[])
+{
+
+  memcpy(&W[1], &a[1], m * sizeof(*W));
+
+  int64_t* const b = &a[m];
+
+  uint64_t i = 1, j = 1, k = 1;
+
+  while(i <= m && j <= n) {
+    if(W[i] <= b[j]) {
+      a[k++] = W[i++];
+    } else {
+      a[k++] = b[j++];
+    }
+  }
+
+// rest of b is already in place
+  while(i <= m) {
+    a[k++] = W[i++];
+  }
+}
+
+// merges a_1,...,a_m with b_1,...,b_n that follows it in memory, n <= s
+// b is copied to W and the merge goes right to left
+static void mergeHigh(int64_t a[], const uint64_t m, const uint64_t n, int64_t W[])
+{
+
+  memcpy(&W[1], &a[m + 1], n * sizeof(*W));
+
+  uint64_t i = m, j = n, k = m + n;
+
+  while(i >= 1 && j >= 1) {
+    if(a[i] > W[j]) {
+      a[k--] = a[i--];
+    } else {
+      a[k--] = W[j--];
+    }
+  }
+
+// rest of a is already in place
+  while(j >= 1) {
+    a[k--] = W[j--];
+  }
+}
+
+static void swapBlocks(int64_t x[], int64_t y[], const uint64_t s)
+{
+  for(uint64_t i = 1; i <= s; ++i) {
+    const int64_t t = x[i];
+    x[i] = y[i];
+    y[i] = t;
+  }
+}
+
+// true if block x with first key kx and number tx goes before block y with first key ky and number ty
+// blocks of A are numbered before blocks of B
+static bool blockBefore(const int64_t kx, const uint64_t tx, const int64_t ky, const uint64_t ty)
+{
+  return kx < ky || (kx == ky && tx < ty);
+}
+
+// merges runs by blocks of s keys, s < min(m, n)
+static void mergeBlocks(int64_t K[], const uint64_t m, const uint64_t n, int64_t W[], const uint64_t s, uint64_t TAG[])
+{
+
+// fragment of A is K_1,...,K_f
+  const uint64_t f = m % s;
+
+// whole blocks of A and B start at K_(f+1), block t is K_(f+ts+1),...,K_(f+ts+s)
+  const uint64_t ka = m / s;
+  const uint64_t kb = n / s;
+  const uint64_t blocks = ka + kb;
+
+  int64_t* const base = &K[f];
+
+  for(uint64_t t = 0; t < blocks; ++t) {
+    TAG[t] = t;
+  }
+
+// selection sort of whole blocks by first key
+  for(uint64_t t = 0; t + 1 < blocks; ++t) {
+
+    uint64_t min = t;
+    for(uint64_t u = t + 1; u < blocks; ++u) {
+      if(blockBefore(base[u * s + 1], TAG[u], base[min * s + 1], TAG[min]))
+        min = u;
+    }
+
+    if(min != t) {
+      swapBlocks(&base[t * s], &base[min * s], s);
+      const uint64_t tag = TAG[t];
+      TAG[t] = TAG[min];
+      TAG[min] = tag;
+    }
+  }
+
+// leftover keys are K_(q+1),...,K_(q+r) just before the next block, they come from A if fromA
+  uint64_t q = 0;
+  uint64_t r = f;
+  bool fromA = true;
+
+  for(uint64_t t = 0; t < blocks; ++t) {
+
+    const bool blockA = TAG[t] < ka;
+
+// block is K_(e+1),...,K_(e+s)
+    const uint64_t e = f + t * s;
+
+// leftover keys from the same run as the block are final
+    if(blockA == fromA || r == 0) {
+      q = e;
+      r = s;
+      fromA = blockA;
+      continue;
+    }
+
+// merge leftover keys in W with the block till one of them runs out
+    memcpy(&W[1], &K[q + 1], r * sizeof(*W));
+
+    uint64_t i = 1, j = e + 1, k = q + 1;
+
+    while(i <= r && j <= e + s) {
+// equal keys go to A first
+      if(fromA ? W[i] <= K[j] : W[i] < K[j]) {
+        K[k++] = W[i++];
+      } else {
+        K[k++] = K[j++];
+      }
+    }
+
+    if(i > r) {
+// leftover keys ran out, rest of the block is left over
+      q = j - 1;
+      r = e + s - q;
+      fromA = blockA;
+    } else {
+// block ran out, rest of leftover keys moves to the end of the block and is still left over
+      const uint64_t rest = r - i + 1;
+      memcpy(&K[k], &W[i], rest * sizeof(*W));
+      q = k - 1;
+      r = rest;
+    }
+  }
+
+// fragment of B after the last whole block
+  const uint64_t g = n % s;
+
+  if(g > 0) {
+    mergeHigh(K, m + n - g, g, W);
+  }
+}
+
+void merge_in_place(const uint64_t m, const uint64_t n; int64_t K[m+n+1], const uint64_t m, const uint64_t n, int64_t W[], const uint64_t s, uint64_t TAG[])
+{
+
+  if(m == 0 || n == 0)
+    return;
+
+// runs are already in order
+  if(K[m] <= K[m + 1])
+    return;
+
+  if(m <= n && m <= s) {
+    mergeLow(K, m, n, W);
+  } else if(n <= s) {
+    mergeHigh(K, m, n, W);
+  } else {
+    mergeBlocks(K, m, n, W, s, TAG);
+  }
+}
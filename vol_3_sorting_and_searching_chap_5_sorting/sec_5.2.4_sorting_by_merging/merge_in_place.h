@@ -0,0 +1,16 @@
+#ifndef MERGE_IN_PLACE_H
+#define MERGE_IN_PLACE_H
+
+// Stable merging of adjacent runs with little workspace
+// 5.2.4 Sorting by Merging
+// The Art of Computer Programming, Donald Knuth
+
+#include <stdint.h>
+
+// merges runs K_1 <= ... <= K_m and K_(m+1) <= ... <= K_(m+n) in place
+// equal keys of the first run come before those of the second
+// W is workspace for s keys W_1,...,W_s, s >= 1
+// TAG is workspace for (m + n) / s + 1 block numbers, not used when s >= min(m, n)
+void merge_in_place(const uint64_t m, const uint64_t n; int64_t K[m+n+1], const uint64_t m, const uint64_t n, int64_t W[], const uint64_t s, uint64_t TAG[]);
+
+#endif
@@ -0,0 +1,539 @@
+// sorted_store.c
+
+// Sorted store of keys inserted in batches
+// with Algorithm Q (Quicksort), 5.2.2 Sorting by Exchanging
+// and Algorithm M (Two-way merge), 5.2.4 Sorting by Merging
+// The Art of Computer Programming, Donald Knuth
+
+#include "sorted_store.h"
+#include "algorithm_m_two_way_merge.h"
+#include "../sec_5.2.2_sorting_by_exchanging/algorithm_q_quicksort.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// sorting the whole file again for every batch costs O(N log N) per batch
+// instead each batch is sorted by itself with Algorithm Q and written as a new level
+// and levels are merged with Algorithm M only when their sizes call for it, in the manner of a log-structured merge tree
+// after a batch is added the two newest levels are merged while the older has no more than ratio times the keys of the newer
+// so each level has more than ratio times the keys of the next, there are O(log N / log ratio) levels
+// and each key is merged O(log N / log ratio) times in all
+
+// a query looks in every level, a key is found by binary search in each
+// a range of keys is the merge with Algorithm M of the part of each level in the range
+
+// levels are files mapped into memory so opening a store reads nothing
+
+// a merge of the two newest levels is written to prefix.tmp.dat and synced to disk
+// then the newer level is renamed to prefix.merged.dat, prefix.tmp.dat is renamed over the older level
+// and prefix.merged.dat is removed
+// each rename is atomic so a merge cut short by a crash leaves one of three states that open recovers from
+// prefix.tmp.dat without prefix.merged.dat, the merge may be incomplete and the levels are intact, prefix.tmp.dat is removed
+// both files, the merge is complete and the newer level is retired, prefix.tmp.dat is renamed over the last level
+// prefix.merged.dat alone, the merge took the place of the older level, prefix.merged.dat is removed
+// so no key is lost or counted twice
+
+#ifdef SORTED_STORE_BUILD_MAIN
+static void usage()
+{
+  puts("usage:sorted_store [-o prefix] [-r ratio] -i | -c | -k key | -q [-l lo] [-u hi]");
+  puts("Implements a sorted store of keys inserted in batches with Algorithm Q (Quicksort), 5.2.2 Sorting by Exchanging and Algorithm M (Two-way merge), 5.2.4 Sorting by Merging, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("keeps sorted level files prefix.1.dat, prefix.2.dat, ... from oldest and largest to newest and smallest");
+  puts("prints the name and number of keys of each level file after -i and -c");
+
+  puts("");
+  puts("binary input data format of a batch");
+  puts("uint64_t N, can be 0 for empty batch");
+  puts("int64_t[N] data");
+
+  puts("");
+  puts("binary output data format of a range and of each level file");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("-o: prefix of level file names, default is store");
+  puts("-r: levels are merged when a level has no more than this many times the keys of the next newer level, at least 1, default is 4");
+  puts("-i: insert batch of keys read from stdin");
+  puts("-c: merge all levels into one sorted file prefix.1.dat");
+  puts("-k: print number of copies of key");
+  puts("-q: output sorted keys with lo <= key <= hi, all keys by default");
+  puts("-l: lowest key of range, default is smallest int64_t");
+  puts("-u: highest key of range, default is largest int64_t");
+
+  puts("");
+  puts("examples:");
+  puts("sorted_store -o /tmp/store -i <data/sorted_store/in.0.le.dat");
+  puts("sorted_store -o /tmp/store -k 503");
+  puts("sorted_store -o /tmp/store -q -l 100 -u 700 | od -An -td8 -w8 -v");
+}
+#endif
+
+// name of level file number i, 0 for the temporary file of a merge
+static void levelName(const struct Store* s, const uint64_t i, char name[])
+{
+  if(i == 0) {
+    sprintf(name, "%s.tmp.dat", s->prefix);
+  } else {
+    sprintf(name, "%s.%" PRIu64 ".dat", s->prefix, i);
+  }
+}
+
+// name of the newer level of a merge once the merged file is complete
+static void mergedName(const struct Store* s, char name[])
+{
+  sprintf(name, "%s.merged.dat", s->prefix);
+}
+
+static bool exists(const char* name)
+{
+  return access(name, F_OK) == 0;
+}
+
+static void renameFile(const char* from, const char* to)
+{
+  if(rename(from, to) != 0) {
+    fprintf(stderr, "error: rename %s: %s\n", from, strerror(errno));
+    exit(2);
+  }
+}
+
+static void removeFile(const char* name)
+{
+  if(unlink(name) != 0 && errno != ENOENT) {
+    fprintf(stderr, "error: unlink %s: %s\n", name, strerror(errno));
+    exit(2);
+  }
+}
+
+// finishes or undoes a merge cut short by a crash as described at the top
+static void recover(const struct Store* s)
+{
+
+  char tmp[strlen(s->prefix) + 32];
+  char merged[strlen(s->prefix) + 32];
+
+  levelName(s, 0, tmp);
+  mergedName(s, merged);
+
+  if(!exists(merged)) {
+    removeFile(tmp);
+    return;
+  }
+
+  if(exists(tmp)) {
+
+// the older level of the merge is the last level left
+    char last[strlen(s->prefix) + 32];
+    uint64_t i = 1;
+    levelName(s, i + 1, last);
+    while(exists(last)) {
+      levelName(s, ++i + 1, last);
+    }
+    levelName(s, i, last);
+
+    renameFile(tmp, last);
+  }
+
+  removeFile(merged);
+}
+
+// maps file name of n keys, creating it with room for n keys if create is true
+// returns NULL if the file does not exist and create is false
+static int64_t* mapFile(const char* name, uint64_t* n, const bool create)
+{
+
+  const int fd = open(name, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+
+  if(fd < 0) {
+    if(!create && errno == ENOENT)
+      return NULL;
+    fprintf(stderr, "error: open %s: %s\n", name, strerror(errno));
+    exit(2);
+  }
+
+  if(create) {
+    if(ftruncate(fd, (*n + 1) * sizeof(int64_t)) != 0) {
+      fprintf(stderr, "error: truncate %s: %s\n", name, strerror(errno));
+      exit(2);
+    }
+  } else {
+    struct stat st;
+    uint64_t count;
+    if(fstat(fd, &st) != 0 || pread(fd, &count, sizeof count, 0) != sizeof count || (uint64_t)st.st_size != (count + 1) * sizeof(int64_t)) {
+      fprintf(stderr, "Invalid input data: %s is not a level file\n", name);
+      exit(1);
+    }
+    *n = count;
+  }
+
+  int64_t* map = mmap(NULL, (*n + 1) * sizeof(*map), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  if(map == MAP_FAILED) {
+    fprintf(stderr, "error: mmap %s: %s\n", name, strerror(errno));
+    exit(2);
+  }
+
+  close(fd);
+
+  if(create)
+    map[0] = *n;
+
+  return map;
+}
+
+static void unmapLevel(struct Level* l)
+{
+  munmap(l->map, (l->n + 1) * sizeof(*l->map));
+  l->map = NULL;
+  l->n = 0;
+}
+
+void store_open(struct Store* s, const char* prefix, const uint64_t ratio)
+{
+
+  s->prefix = prefix;
+  s->ratio = ratio;
+  s->levels = 0;
+
+  recover(s);
+
+  char name[strlen(prefix) + 32];
+
+  for(;;) {
+
+    levelName(s, s->levels + 1, name);
+
+    uint64_t n;
+    int64_t* map = mapFile(name, &n, false);
+
+    if(map == NULL)
+      break;
+
+    if(s->levels == STORE_LEVELS_MAX) {
+      fprintf(stderr, "Invalid input data: more than %d level files\n", STORE_LEVELS_MAX);
+      exit(1);
+    }
+
+    s->level[s->levels++] = (struct Level){map, n};
+  }
+}
+
+void store_close(struct Store* s)
+{
+  for(uint64_t i = 0; i < s->levels; ++i) {
+    unmapLevel(&s->level[i]);
+  }
+  s->levels = 0;
+}
+
+// merges the two newest levels into one
+static void mergeNewest(struct Store* s)
+{
+
+  struct Level* const x = &s->level[s->levels - 2];
+  struct Level* const y = &s->level[s->levels - 1];
+
+  char tmp[strlen(s->prefix) + 32];
+  char older[strlen(s->prefix) + 32];
+  char newer[strlen(s->prefix) + 32];
+  char merged[strlen(s->prefix) + 32];
+
+  levelName(s, 0, tmp);
+  levelName(s, s->levels - 1, older);
+  levelName(s, s->levels, newer);
+  mergedName(s, merged);
+
+  uint64_t n = x->n + y->n;
+  int64_t* z = mapFile(tmp, &n, true);
+
+// keys of a level file begin at map[1] so Algorithm M merges the files as they are
+  merge_simd(x->map, x->n, y->map, y->n, z);
+  z[0] = n;
+
+// the merged file must be complete on disk before the newer level is retired
+  if(msync(z, (n + 1) * sizeof(*z), MS_SYNC) != 0) {
+    fprintf(stderr, "error: msync %s: %s\n", tmp, strerror(errno));
+    exit(2);
+  }
+
+  unmapLevel(x);
+  unmapLevel(y);
+
+// a crash between these steps is recovered by store_open
+  renameFile(newer, merged);
+  renameFile(tmp, older);
+  removeFile(merged);
+
+  *x = (struct Level){z, n};
+  --s->levels;
+}
+
+void store_insert(const uint64_t n; struct Store* s, const int64_t K[n + 1], const uint64_t n)
+{
+
+  if(n == 0)
+    return;
+
+  if(s->levels == STORE_LEVELS_MAX) {
+    store_compact(s);
+  }
+
+// Algorithm Q needs K_0 = -infinity and K_(n+1) = +infinity, which the level file has no room for
+  int64_t* R = malloc((n + 2) * sizeof(*R));
+
+  if(R == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  R[0] = INT64_MIN;
+  R[n + 1] = INT64_MAX;
+  memcpy(&R[1], &K[1], n * sizeof(*R));
+
+  Sort(n, R);
+
+  char name[strlen(s->prefix) + 32];
+  levelName(s, s->levels + 1, name);
+
+  uint64_t count = n;
+  int64_t* map = mapFile(name, &count, true);
+  memcpy(&map[1], &R[1], n * sizeof(*map));
+
+  free(R);
+
+  s->level[s->levels++] = (struct Level){map, n};
+
+// merge while the older level has no more than ratio times the keys of the newer
+  while(s->levels >= 2 && s->level[s->levels - 2].n <= s->ratio * s->level[s->levels - 1].n) {
+    mergeNewest(s);
+  }
+}
+
+void store_compact(struct Store* s)
+{
+  while(s->levels >= 2) {
+    mergeNewest(s);
+  }
+}
+
+// smallest i with 1 <= i <= n and key <= K_i, n + 1 if there is none
+// with strict true, smallest i with key < K_i
+static uint64_t search(const uint64_t n; const int64_t K[n + 1], const uint64_t n, const int64_t key, const bool strict)
+{
+
+  uint64_t lo = 1, hi = n + 1;
+
+  while(lo < hi) {
+    const uint64_t mid = lo + (hi - lo) / 2;
+    if(K[mid] < key || (strict && K[mid] == key)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+uint64_t store_count(const struct Store* s, const int64_t key)
+{
+
+  uint64_t count = 0;
+
+  for(uint64_t i = 0; i < s->levels; ++i) {
+    const struct Level* const l = &s->level[i];
+    count += search(l->map, l->n, key, true) - search(l->map, l->n, key, false);
+  }
+
+  return count;
+}
+
+uint64_t store_range(const struct Store* s, const int64_t lo, const int64_t hi, int64_t** out)
+{
+
+// keys of level i in the range are map[first[i]],...,map[last[i] - 1]
+  uint64_t first[STORE_LEVELS_MAX];
+  uint64_t last[STORE_LEVELS_MAX];
+  uint64_t total = 0;
+
+  for(uint64_t i = 0; i < s->levels; ++i) {
+    const struct Level* const l = &s->level[i];
+    first[i] = search(l->map, l->n, lo, false);
+    last[i] = lo <= hi ? search(l->map, l->n, hi, true) : first[i];
+    total += last[i] - first[i];
+  }
+
+// result is merged level by level into z, with w as the other buffer
+  int64_t* z = malloc((total + 1) * sizeof(*z));
+  int64_t* w = malloc((total + 1) * sizeof(*w));
+
+  if(z == NULL || w == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  uint64_t count = 0;
+
+  for(uint64_t i = 0; i < s->levels; ++i) {
+
+    const uint64_t n = last[i] - first[i];
+
+    if(n == 0)
+      continue;
+
+// pointer is offset so the part in the range is again indexed from 1
+    merge_simd(z, count, &s->level[i].map[first[i] - 1], n, w);
+
+    int64_t* const t = z;
+    z = w;
+    w = t;
+    count += n;
+  }
+
+  free(w);
+
+  *out = z;
+
+  return count;
+}
+
+#ifdef SORTED_STORE_BUILD_MAIN
+
+int main(int argc, char* argv[])
+{
+
+// level files are prefix.1.dat, prefix.2.dat, ...
+  const char* prefix = "store";
+
+// size ratio of levels
+  uint64_t ratio = 4;
+
+// operation
+  int op = 0;
+
+// key of -k and range of -q
+  int64_t key = 0;
+  int64_t lo = INT64_MIN;
+  int64_t hi = INT64_MAX;
+
+  for(int opt; (opt = getopt(argc, argv, "chik:l:o:qr:u:")) != -1;) {
+    switch(opt) {
+      case 'c':
+      case 'i':
+      case 'k':
+      case 'q':
+        if(op != 0) {
+          usage();
+          exit(1);
+        }
+        op = opt;
+        if(opt == 'k')
+          key = strtoll(optarg, NULL, 10);
+        break;
+      case 'l':
+        lo = strtoll(optarg, NULL, 10);
+        break;
+      case 'u':
+        hi = strtoll(optarg, NULL, 10);
+        break;
+      case 'o':
+        prefix = optarg;
+        break;
+      case 'r':
+        ratio = strtoull(optarg, NULL, 10);
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind < argc || op == 0 || ratio == 0) {
+    usage();
+    exit(1);
+  }
+
+  struct Store s;
+  store_open(&s, prefix, ratio);
+
+  if(op == 'i') {
+
+// read 64-bit size of batch as binary data
+    uint64_t N;
+    if(fread(&N, sizeof N, 1, stdin) != 1) {
+      fprintf(stderr, "Invalid input data: no number of keys\n");
+      usage();
+      exit(1);
+    }
+
+// allocate N+1 entries to use array indexing from 1 instead of 0
+    int64_t* K = malloc((N + 1) * sizeof(*K));
+
+    if(K == NULL) {
+      fprintf(stderr, "error: malloc failure\n");
+      exit(2);
+    }
+
+    const uint64_t got = fread(&K[1], sizeof(*K), N, stdin);
+
+    if(got != N) {
+      fprintf(stderr, "Invalid input data: input ends %" PRIu64 " keys short\n", N - got);
+      usage();
+      exit(1);
+    }
+
+    store_insert(&s, K, N);
+
+    free(K);
+  }
+
+  if(op == 'c') {
+    store_compact(&s);
+  }
+
+  if(op == 'i' || op == 'c') {
+    char name[strlen(prefix) + 32];
+    for(uint64_t i = 0; i < s.levels; ++i) {
+      levelName(&s, i + 1, name);
+      printf("%s %" PRIu64 "\n", name, s.level[i].n);
+    }
+  }
+
+  if(op == 'k') {
+    printf("%" PRIu64 "\n", store_count(&s, key));
+  }
+
+  if(op == 'q') {
+
+    int64_t* Z;
+    const uint64_t zsize = store_range(&s, lo, hi, &Z);
+
+// write number of values to follow
+    fwrite(&zsize, sizeof zsize, 1, stdout);
+
+// print keys in range as binary data
+    fwrite(&Z[1], sizeof(*Z), zsize, stdout);
+
+    free(Z);
+  }
+
+  store_close(&s);
+
+  return 0;
+}
+
+#endif
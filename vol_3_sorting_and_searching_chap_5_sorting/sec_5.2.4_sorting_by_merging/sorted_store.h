@@ -0,0 +1,48 @@
+#ifndef SORTED_STORE_H
+#define SORTED_STORE_H
+
+// Sorted store of keys inserted in batches
+// with Algorithm Q (Quicksort), 5.2.2 Sorting by Exchanging
+// and Algorithm M (Two-way merge), 5.2.4 Sorting by Merging
+// The Art of Computer Programming, Donald Knuth
+
+#include <stdint.h>
+
+// most levels a store can have, each level has more than ratio times the keys of the next
+#define STORE_LEVELS_MAX 64
+
+// sorted level file mapped into memory
+// the file is uint64_t n followed by int64_t[n] sorted keys, so the keys are map[1],...,map[n]
+struct Level {
+  int64_t* map;
+  uint64_t n;
+};
+
+// levels are files prefix.1.dat, prefix.2.dat, ... from oldest and largest to newest and smallest
+struct Store {
+  const char* prefix;
+  uint64_t ratio;
+  uint64_t levels;
+  struct Level level[STORE_LEVELS_MAX];
+};
+
+// maps the level files of prefix that exist, a new store has none
+// levels are merged when a level has no more than ratio times the keys of the next newer level
+void store_open(struct Store* s, const char* prefix, const uint64_t ratio);
+
+void store_close(struct Store* s);
+
+// sorts K_1,...,K_n into a new level and merges levels as their sizes require
+void store_insert(const uint64_t n; struct Store* s, const int64_t K[n + 1], const uint64_t n);
+
+// merges all levels into prefix.1.dat
+void store_compact(struct Store* s);
+
+// number of copies of key
+uint64_t store_count(const struct Store* s, const int64_t key);
+
+// sorted keys lo <= key <= hi go to (*out)[1],...,(*out)[count], *out must be freed
+// returns count
+uint64_t store_range(const struct Store* s, const int64_t lo, const int64_t hi, int64_t** out);
+
+#endif
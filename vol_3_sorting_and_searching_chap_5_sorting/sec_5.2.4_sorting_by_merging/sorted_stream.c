@@ -0,0 +1,136 @@
+// sorted_stream.c
+
+// Buffered reading and writing of sorted files for merging
+// 5.2.4 Sorting by Merging
+// The Art of Computer Programming, Donald Knuth
+
+#include "sorted_stream.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// buffers are read and written with read and write system calls without stdio in between
+// so keys are copied once between the kernel and the buffer
+
+// reads exactly size bytes unless the file ends first
+// returns number of bytes read
+static uint64_t readFully(const struct Stream* s, void* data, const uint64_t size)
+{
+
+  uint64_t done = 0;
+
+  while(done < size) {
+
+    const ssize_t got = read(s->fd, (char*)data + done, size - done);
+
+    if(got == 0)
+      break;
+
+    if(got < 0) {
+      if(errno == EINTR)
+        continue;
+      fprintf(stderr, "error: read %s: %s\n", s->name, strerror(errno));
+      exit(2);
+    }
+
+    done += got;
+  }
+
+  return done;
+}
+
+void write_fully(const void* data, const uint64_t size)
+{
+
+  uint64_t done = 0;
+
+  while(done < size) {
+
+    const ssize_t put = write(STDOUT_FILENO, (const char*)data + done, size - done);
+
+    if(put < 0) {
+      if(errno == EINTR)
+        continue;
+      fprintf(stderr, "error: write: %s\n", strerror(errno));
+      exit(2);
+    }
+
+    done += put;
+  }
+}
+
+void stream_open(struct Stream* s, const char* name, const uint64_t keys, void (*usage)(void))
+{
+
+  s->name = name;
+  s->usage = usage;
+  s->fd = open(name, O_RDONLY);
+
+  if(s->fd < 0) {
+    fprintf(stderr, "error: open %s: %s\n", name, strerror(errno));
+    exit(2);
+  }
+
+// the file is read once from start to end, fails harmlessly on pipes
+  posix_fadvise(s->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  if(readFully(s, &s->unread, sizeof s->unread) != sizeof s->unread) {
+    fprintf(stderr, "Invalid input data: %s has no number of keys\n", name);
+    usage();
+    exit(1);
+  }
+
+  s->keys = keys;
+  s->buf = malloc(keys * sizeof(*s->buf));
+
+  if(s->buf == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  s->next = s->last = 0;
+}
+
+void stream_close(struct Stream* s)
+{
+  free(s->buf);
+  close(s->fd);
+}
+
+bool stream_fill(struct Stream* s)
+{
+
+  if(s->next < s->last)
+    return true;
+
+  if(s->unread == 0)
+    return false;
+
+  const uint64_t want = s->unread < s->keys ? s->unread : s->keys;
+  const uint64_t got = readFully(s, s->buf, want * sizeof(*s->buf));
+
+  if(got != want * sizeof(*s->buf)) {
+    fprintf(stderr, "Invalid input data: %s ends %" PRIu64 " keys short\n", s->name, s->unread - got / sizeof(*s->buf));
+    s->usage();
+    exit(1);
+  }
+
+  s->unread -= want;
+  s->next = 0;
+  s->last = want;
+
+  return true;
+}
+
+void output_flush(struct Output* z)
+{
+  write_fully(z->buf, z->next * sizeof(*z->buf));
+  z->next = 0;
+}
@@ -0,0 +1,52 @@
+#ifndef SORTED_STREAM_H
+#define SORTED_STREAM_H
+
+// Buffered reading and writing of sorted files for merging
+// 5.2.4 Sorting by Merging
+// The Art of Computer Programming, Donald Knuth
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// sorted input file read a buffer at a time
+// the file is uint64_t N followed by int64_t[N] keys
+struct Stream {
+// name for error messages
+  const char* name;
+  int fd;
+// number of keys in buffer when full
+  uint64_t keys;
+// keys in the file not yet read into the buffer
+  uint64_t unread;
+// buffer holds keys buf[next],...,buf[last - 1] not yet merged
+  int64_t* buf;
+  uint64_t next;
+  uint64_t last;
+// usage of the program, shown after invalid input data
+  void (*usage)(void);
+};
+
+// output buffer written to stdout when full
+struct Output {
+  int64_t* buf;
+  uint64_t next;
+  uint64_t keys;
+};
+
+// opens file name, reads its number of keys into s->unread and allocates a buffer of keys
+void stream_open(struct Stream* s, const char* name, const uint64_t keys, void (*usage)(void));
+
+// frees the buffer and closes the file
+void stream_close(struct Stream* s);
+
+// refills buffer of s when all its keys have been merged
+// returns false at end of file
+bool stream_fill(struct Stream* s);
+
+// writes exactly size bytes to stdout
+void write_fully(const void* data, const uint64_t size);
+
+// writes the keys in the buffer of z and empties it
+void output_flush(struct Output* z);
+
+#endif
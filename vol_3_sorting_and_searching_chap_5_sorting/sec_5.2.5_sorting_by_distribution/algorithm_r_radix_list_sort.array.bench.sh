@@ -0,0 +1,91 @@
+#!/bin/bash
+
+# algorithm_r_radix_list_sort.array.bench.sh
+
+# benchmark for write-combining in algorithm_r_radix_list_sort.array.c
+# usage: algorithm_r_radix_list_sort.array.bench.sh [-n N] [-p program]
+
+function usage {
+  echo "usage: algorithm_r_radix_list_sort.array.bench.sh [-n N] [-p program]"
+  echo "sorts N random 64-bit keys with plain distribution, write-combining (-w) and non-temporal write-combining (-n)"
+  echo "prints elapsed time, throughput and dTLB misses counted by perf if it is installed"
+  echo "-n: number of keys, default is 100000000"
+  echo "-p: path of algorithm_r_radix_list_sort.array program, default is from PATH"
+}
+
+while getopts "hn:p:" opt; do
+  case $opt in
+    h) usage; exit 0;;
+    n) n=$OPTARG;;
+    p) program=$OPTARG;;
+    *) usage; exit 1
+  esac
+done
+shift $((OPTIND-1))
+
+: ${n:=100000000} ${program:=algorithm_r_radix_list_sort.array}
+
+set -o pipefail
+
+# input goes in a temporary file that is removed on exit, also when interrupted
+infile=$(mktemp) || exit 1
+trap 'rm -f "$infile"' EXIT
+
+# binary input is M = 0 and p = 0 to choose radix and passes automatically, then N and N random keys
+function le64 {
+  local hex
+  printf -vhex "%.16x" $1
+  for((j=14; j >= 0; j-=2)); do
+    printf "\x${hex:j:2}"
+  done
+}
+
+{
+  le64 0
+  le64 0
+  le64 $n
+  head -c $((8 * n)) /dev/urandom
+} > "$infile"
+
+echo "bench pid $$ algorithm_r_radix_list_sort.array N $n"
+
+if command -v perf >/dev/null; then
+  perf=true
+else
+  perf=false
+  echo "perf not found, dTLB misses not counted"
+fi
+
+printf "%-8s %10s %12s %18s %18s\n" mode seconds Mkeys/s dTLB-load-misses dTLB-store-misses
+
+for mode in plain -w -n; do
+
+  args=()
+  [[ $mode != plain ]] && args=($mode)
+
+  start=$(date +%s%N)
+
+  if $perf; then
+    counts=$(perf stat -x, -e dTLB-load-misses,dTLB-store-misses $program "${args[@]}" <"$infile" 2>&1 >/dev/null | cut -d, -f1 | paste -sd' ')
+    es=$?
+  else
+    $program "${args[@]}" <"$infile" >/dev/null
+    es=$?
+    counts="- -"
+  fi
+
+  end=$(date +%s%N)
+
+  if ((es)); then
+    echo "bench run $mode es $es"
+    exit $es
+  fi
+
+  read load_misses store_misses <<<"$counts"
+
+# elapsed time in milliseconds and throughput in thousands of keys per second
+  ((ms = (end - start) / 1000000, ms = ms > 0 ? ms : 1))
+  ((kps = n / ms))
+  printf "%-8s %6d.%03d %8d.%03d %18s %18s\n" $mode $((ms/1000)) $((ms%1000)) $((kps/1000)) $((kps%1000)) $load_misses $store_misses
+
+done
@@ -0,0 +1,426 @@
+// algorithm_r_radix_list_sort.array.c
+
+// Algorithm R (Radix list sort) on arrays instead of linked lists
+// 5.2.5 Sorting by Distribution
+// The Art of Computer Programming, Donald Knuth
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// least significant digit first radix sort like Algorithm R
+// but records are moved between two arrays instead of being linked into piles
+// this avoids following a link to a random record at every step of a pass
+// each pass is Algorithm 5.2D (Distribution counting) applied to one digit of the key
+// the piles of Algorithm R become consecutive areas of the destination array
+// whose starting offsets are prefix sums of the counts of keys with each digit
+// the source array is read in order and each pile is written in order so the sort is stable
+// and the output is identical to algorithm_r_radix_list_sort
+
+// the counts for all p digits are found in a single pass over the keys before sorting
+// since moving keys around does not change how many keys have a given digit
+// a pass is skipped when all N keys have the same digit since it would not move any key
+
+// with write-combining each key is first put in a small buffer for its pile the size of a cache line
+// and a full buffer is written to the destination array all at once
+// so a pass touches at most M lines and their pages at a time in the buffers, which stay in cache,
+// instead of writing each key straight to one of M distant places in the destination array
+// buffers are aligned with the lines of the destination array so every full buffer fills one whole line
+// which can be written with non-temporal stores that go to memory without first reading the line into cache
+
+// radix M is a power of 2, M = 2^lgM, so a digit is a field of lgM bits in the key
+
+// smallest radix supported is 2^4
+#define LG_M_MIN 4u
+
+// largest radix supported is 2^16
+#define LG_M_MAX 16u
+
+// largest radix chosen automatically is 2^13
+// counts for 2^13 piles take 64KiB and stay in level 2 cache while keys stream through
+#define LG_M_AUTO_MAX 13u
+
+// largest radix chosen automatically with write-combining is 2^11
+// buffers for 2^11 piles take 128KiB and stay in level 2 cache
+#define LG_M_AUTO_MAX_BUFFERED 11u
+
+// size of a cache line in bytes
+#define LINE_SIZE 64u
+
+// number of keys in a cache line
+#define LINE (LINE_SIZE / sizeof(uint64_t))
+
+
+static void usage()
+{
+  puts("usage:algorithm_r_radix_list_sort.array [-w] [-n] <in.dat >out.dat");
+  puts("Implements Algorithm R (Radix list sort) with arrays instead of linked lists, 5.2.5 Sorting by Distribution, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
+
+  puts("-w: write-combining, move keys through cache line sized buffers for each pile");
+  puts("-n: non-temporal stores for full buffers, implies -w");
+
+  puts("first uint64_t is base or radix M to use, any power of 2 from 16 to 65536");
+  puts("M = 0 chooses M automatically from number of values and number of bits in the largest value");
+  puts("second uint64_t is length p of values in base M, e.g. p = 2 with M = 256 means values fit into 2 bytes");
+  puts("p = 0 derives p from number of bits in the largest value");
+  puts("third uint64_t is number of values to sort");
+  puts("next that many int64_t is data to sort");
+
+  puts("");
+  puts("binary input data format");
+  puts("uint64_t M");
+  puts("uint64_t p");
+  puts("uint64_t N");
+  puts("int64_t[N] data");
+
+  puts("");
+  puts("binary output data format");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("examples:");
+  puts("algorithm_r_radix_list_sort.array <data/algorithm_r_radix_list_sort.array/in.0.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_r_radix_list_sort.array -n <data/algorithm_r_radix_list_sort.array/in.7.le.dat | od -An -td8 -w8 -v");
+}
+
+// Count fills COUNT[k - 1][i] with the number of keys K_1,...,K_N whose kth least significant digit is i
+// for all p digits at once in a single pass over the keys
+static void Count(const uint64_t N, const uint64_t K[N + 1], const uint64_t M, const uint64_t p, uint64_t COUNT[p][M])
+{
+
+  const uint64_t lgM = __builtin_ctzll(M);
+
+  memset(COUNT, 0, p * M * sizeof(**COUNT));
+
+  for(uint64_t j = 1; j <= N; ++j) {
+
+    const uint64_t key = K[j];
+
+    for(uint64_t k = 1; k <= p; ++k) {
+      ++COUNT[k - 1][(key >> (lgM * (k - 1))) & (M - 1)];
+    }
+  }
+
+}
+
+// write_line writes a full buffer of LINE keys to a line of the destination array
+// nt selects non-temporal stores
+static inline void write_line(uint64_t* restrict dst, const uint64_t* restrict BUF, const bool nt)
+{
+
+#if defined(__SSE2__)
+  if(nt) {
+    for(uint64_t s = 0; s < LINE; s += 2) {
+      _mm_stream_si128((__m128i*)&dst[s], _mm_load_si128((const __m128i*)&BUF[s]));
+    }
+    return;
+  }
+#else
+  (void)nt;
+#endif
+
+  memcpy(dst, BUF, LINE * sizeof(*dst));
+}
+
+// Distribute moves N keys from src to the tops of their piles in dst through write-combining buffers
+// dst must be aligned to LINE_SIZE
+// TOP[i] is index in dst of next key for pile i, and BOTM[i] is index of the first key of pile i
+// key at index j of dst waits in BUF[i][j % LINE] till the line of dst holding index j is full
+static void Distribute(const uint64_t N, const uint64_t src[N + 1], uint64_t dst[N + 1], const uint64_t M, const uint64_t shift, uint64_t TOP[M], const uint64_t BOTM[M], uint64_t BUF[M][LINE], const bool nt)
+{
+
+  for(uint64_t j = 1; j <= N; ++j) {
+
+    const uint64_t key = src[j];
+    const uint64_t i = (key >> shift) & (M - 1);
+
+    const uint64_t top = TOP[i]++;
+    BUF[i][top % LINE] = key;
+
+// write buffer when it has the last key of a line
+    if(top % LINE == LINE - 1) {
+
+      const uint64_t line = top - (LINE - 1);
+
+// first line of a pile is shared with the previous pile, write only this pile's part
+      if(line < BOTM[i]) {
+        memcpy(&dst[BOTM[i]], &BUF[i][BOTM[i] % LINE], (top + 1 - BOTM[i]) * sizeof(*dst));
+      } else {
+        write_line(&dst[line], BUF[i], nt);
+      }
+    }
+  }
+
+// write what is left in partly filled buffers
+  for(uint64_t i = 0; i < M; ++i) {
+
+    const uint64_t top = TOP[i];
+    if(top % LINE == 0)
+      continue;
+
+    uint64_t first = top - top % LINE;
+    if(first < BOTM[i])
+      first = BOTM[i];
+
+    memcpy(&dst[first], &BUF[i][first % LINE], (top - first) * sizeof(*dst));
+  }
+
+#if defined(__SSE2__)
+// make non-temporal stores visible before keys are read in next pass
+  if(nt) {
+    _mm_sfence();
+  }
+#endif
+
+}
+
+// Sort takes array K of N keys beginning at K[1] and workspace array W of N + 1 keys
+// M is radix or base, a power of 2 from 2^LG_M_MIN to 2^LG_M_MAX
+// p is length of key in base M
+// wc selects write-combining buffers, K and W must then be aligned to LINE_SIZE
+// nt selects non-temporal stores for write-combining buffers
+// Sort implements Algorithm R (Radix list sort) with arrays
+// returns K or W, whichever holds the sorted keys beginning at index 1
+uint64_t* Sort(const uint64_t N, uint64_t K[N + 1], uint64_t W[N + 1], const uint64_t M, const uint64_t p, const bool wc, const bool nt)
+{
+
+  if(N == 0)
+    return K;
+
+  const uint64_t lgM = __builtin_ctzll(M);
+
+// counts of each digit for all p digits
+  uint64_t (*COUNT)[M] = malloc(p * M * sizeof(**COUNT));
+
+  if(COUNT == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  Count(N, K, M, p, COUNT);
+
+// write-combining buffers and first index of each pile
+  uint64_t (*BUF)[LINE] = NULL;
+  uint64_t* BOTM = NULL;
+
+  if(wc) {
+    BUF = aligned_alloc(LINE_SIZE, M * sizeof(*BUF));
+    BOTM = malloc(M * sizeof(*BOTM));
+
+    if(BUF == NULL || BOTM == NULL) {
+      fprintf(stderr, "error: malloc failure\n");
+      exit(2);
+    }
+  }
+
+// source and destination arrays switch roles after every pass
+  uint64_t* src = K;
+  uint64_t* dst = W;
+
+// loop on k like R1, perform a distribution pass for k = 1,2,...,p
+  for(uint64_t k = 1; k <= p; ++k) {
+
+// position of kth least significant digit in key
+    const uint64_t shift = lgM * (k - 1);
+
+// skip pass if one pile would hold every key
+    if(COUNT[k - 1][(src[1] >> shift) & (M - 1)] == N)
+      continue;
+
+// set piles empty like R2
+// pile i begins in destination array after the piles for all smaller digits
+// TOP[i] is index of next free position in pile i
+    uint64_t* TOP = COUNT[k - 1];
+    for(uint64_t i = 0, sum = 1; i < M; ++i) {
+      const uint64_t count = TOP[i];
+      TOP[i] = sum;
+      sum += count;
+    }
+
+// extract kth digit of key like R3 and add record to top of its pile like R4
+// step to next record in order like R5
+    if(wc) {
+      memcpy(BOTM, TOP, M * sizeof(*BOTM));
+      Distribute(N, src, dst, M, shift, TOP, BOTM, BUF, nt);
+    } else {
+      for(uint64_t j = 1; j <= N; ++j) {
+        const uint64_t key = src[j];
+        dst[TOP[(key >> shift) & (M - 1)]++] = key;
+      }
+    }
+
+// piles are already hooked together like R6 since they are consecutive in destination array
+    uint64_t* tmp = src;
+    src = dst;
+    dst = tmp;
+
+  }
+
+  free(BOTM);
+  free(BUF);
+  free(COUNT);
+
+  return src;
+
+}
+
+// number of bits needed for largest of N keys
+static uint64_t KeyBits(const uint64_t N, const uint64_t K[N + 1])
+{
+
+// OR of all keys has the same highest 1 bit as the largest key
+  uint64_t bits = 0;
+  for(uint64_t i = 1; i <= N; ++i) {
+    bits |= K[i];
+  }
+
+  return bits == 0 ? 0 : 64 - __builtin_clzll(bits);
+}
+
+// chooses lg M for N keys of b bits
+// a pass costs about N + M so radix M is kept no larger than N
+// the fewest passes p with M no larger than 2^lgMax are chosen
+// then digits are made just wide enough for p passes
+static uint64_t ChooseLgM(const uint64_t N, const uint64_t b, const uint64_t lgMax)
+{
+
+// bits in N
+  const uint64_t lgN = N == 0 ? 0 : 64 - __builtin_clzll(N);
+
+  uint64_t lgM = lgMax;
+  if(lgN < lgM)
+    lgM = lgN;
+  if(lgM < LG_M_MIN)
+    lgM = LG_M_MIN;
+
+  if(b == 0)
+    return lgM;
+
+// fewest passes for digits of lgM bits
+  const uint64_t p = (b + lgM - 1) / lgM;
+
+// narrowest digits for p passes
+  lgM = (b + p - 1) / p;
+  if(lgM < LG_M_MIN)
+    lgM = LG_M_MIN;
+
+  return lgM;
+}
+
+int main(int argc, char* argv[])
+{
+
+// write-combining
+  bool wc = false;
+// non-temporal stores
+  bool nt = false;
+
+  for(int opt; (opt = getopt(argc, argv, "hnw")) != -1;) {
+    switch(opt) {
+      case 'n':
+        nt = true;
+        wc = true;
+        break;
+      case 'w':
+        wc = true;
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind < argc) {
+    usage();
+    exit(1);
+  }
+
+// M is radix
+  uint64_t M;
+  fread(&M, sizeof M, 1, stdin);
+
+  if(M != 0 && (M & (M - 1)) != 0) {
+    fprintf(stderr, "Invalid input data: radix M must be a power of 2\n");
+    usage();
+    exit(1);
+  }
+
+  if(M != 0 && (M < UINT64_C(1) << LG_M_MIN || M > UINT64_C(1) << LG_M_MAX)) {
+    fprintf(stderr, "Invalid input data: radix M must be from %" PRIu64 " to %" PRIu64 "\n", UINT64_C(1) << LG_M_MIN, UINT64_C(1) << LG_M_MAX);
+    usage();
+    exit(1);
+  }
+
+// p is key length in base M
+  uint64_t p;
+  fread(&p, sizeof p, 1, stdin);
+
+// read 64-bit size of data array as binary data
+  uint64_t N;
+  fread(&N, sizeof N, 1, stdin);
+
+// arrays of keys and workspace are too big for the stack when N is large
+// allocate N+1 entries to use array indexing from 1 instead of 0
+// aligned to cache lines for write-combining, size must be a multiple of the alignment
+  const size_t size = ((N + 1) * sizeof(uint64_t) + LINE_SIZE - 1) / LINE_SIZE * LINE_SIZE;
+  uint64_t* K = aligned_alloc(LINE_SIZE, size);
+  uint64_t* W = aligned_alloc(LINE_SIZE, size);
+
+  if(K == NULL || W == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+// read array K of keys as binary data
+  fread(&K[1], sizeof(*K), N, stdin);
+
+// bits in largest key
+  const uint64_t b = KeyBits(N, K);
+
+// choose radix from the data if M = 0
+  if(M == 0) {
+    M = UINT64_C(1) << ChooseLgM(N, b, wc ? LG_M_AUTO_MAX_BUFFERED : LG_M_AUTO_MAX);
+  }
+
+  const uint64_t lgM = __builtin_ctzll(M);
+
+// derive key length from the data if p = 0
+  if(p == 0) {
+    p = b == 0 ? 1 : (b + lgM - 1) / lgM;
+  }
+
+// all but the last digit must lie inside the 64-bit key
+  if(p - 1 > 63 / lgM) {
+    fprintf(stderr, "Invalid input data: key length p must be at most %" PRIu64 " digits for radix M = %" PRIu64 "\n", 63 / lgM + 1, M);
+    usage();
+    exit(1);
+  }
+
+  const uint64_t* const sorted = Sort(N, K, W, M, p, wc, nt);
+
+// write number of values to follow
+  fwrite(&N, sizeof N, 1, stdout);
+
+// print sorted array as binary data
+  fwrite(&sorted[1], sizeof(*sorted), N, stdout);
+
+  free(W);
+  free(K);
+
+  return 0;
+}
@@ -7,11 +7,25 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <math.h>
 
+// radix M is a power of 2, M = 2^lgM, so a digit is a field of lgM bits in the key
+
+// smallest radix supported is 2^4
+#define LG_M_MIN 4u
+
+// largest radix supported is 2^16
+#define LG_M_MAX 16u
+
+// largest radix chosen automatically is 2^13
+// TOP and BOTM for 2^13 piles take 128KiB and stay in level 2 cache while records stream through
+#define LG_M_AUTO_MAX 13u
+
 
 static void usage()
 {
@@ -20,8 +34,10 @@ static void usage()
 
   puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
 
-  puts("first uint64_t is base or radix M to use, currently only 256 is supported");
-  puts("second uint64_t is length p of values in base M, e.g. p = 2 means values fit into 2 bytes");
+  puts("first uint64_t is base or radix M to use, any power of 2 from 16 to 65536");
+  puts("M = 0 chooses M automatically from number of values and number of bits in the largest value");
+  puts("second uint64_t is length p of values in base M, e.g. p = 2 with M = 256 means values fit into 2 bytes");
+  puts("p = 0 derives p from number of bits in the largest value");
   puts("third uint64_t is number of values to sort");
   puts("next that many int64_t is data to sort");
 
@@ -40,6 +56,7 @@ static void usage()
   puts("");
   puts("examples:");
   puts("algorithm_r_radix_list_sort <data/algorithm_r_radix_list_sort/in.0.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_r_radix_list_sort <data/algorithm_r_radix_list_sort/in.9.le.dat | od -An -td8 -w8 -v");
 }
 
 struct Record {
@@ -49,40 +66,91 @@ struct Record {
   uint64_t KEY;
 };
 
+// the nonempty piles of a pass are kept in a two-level bitmap
+// bit i of PILE is set when pile i is nonempty
+// bit w of PILE_WORD is set when word w of PILE is nonzero
+// so the nonempty piles are found in order without looking at every one of the M piles
+// PILE has ceil(M/64) words and PILE_WORD has ceil(M/4096) words, at most 1024 and 16 for M = 2^16
+
+// number of 64-bit words in PILE bitmap for M piles
+static uint64_t pile_words(const uint64_t M)
+{
+  return (M + 63) / 64;
+}
+
+// number of 64-bit words in PILE_WORD bitmap for M piles
+static uint64_t pile_word_words(const uint64_t M)
+{
+  return (pile_words(M) + 63) / 64;
+}
+
+// marks pile i nonempty
+static inline void mark_pile(uint64_t PILE[], uint64_t PILE_WORD[], const uint64_t i)
+{
+  PILE[i / 64] |= UINT64_C(1) << (i % 64);
+  PILE_WORD[i / 4096] |= UINT64_C(1) << (i / 64 % 64);
+}
+
+// finds first nonempty pile i >= j, returns M if there is none
+static uint64_t find_pile(const uint64_t M, const uint64_t PILE[], const uint64_t PILE_WORD[], const uint64_t j)
+{
+
+  if(j >= M)
+    return M;
+
+// look for a nonempty pile in the same word as j
+  const uint64_t bits = PILE[j / 64] & (~UINT64_C(0) << (j % 64));
+  if(bits != 0)
+    return j / 64 * 64 + __builtin_ctzll(bits);
+
+// look for the next nonzero word w of PILE
+  const uint64_t w = j / 64 + 1;
+  for(uint64_t s = w / 64; s < pile_word_words(M); ++s) {
+
+    uint64_t words = PILE_WORD[s];
+    if(s == w / 64)
+      words &= ~UINT64_C(0) << (w % 64);
+
+    if(words != 0) {
+      const uint64_t v = 64 * s + __builtin_ctzll(words);
+      return 64 * v + __builtin_ctzll(PILE[v]);
+    }
+  }
+
+  return M;
+}
+
 // implements Algorithm H (Hooking-up of queues)
 // takes M queues with nodes pointing from head to tail
 // head of each queue is at BOTM[i]
 // tail of each queue is at TOP[i]
 // links all M queues together into single queue with tail at BOTM[0] and TOP[0] pointing to a node at BOTM[j] where j > i is the next nonempty queue
 // the case of empty queue 0 is tricky and relies on the special way front and rear pointers are defined for these queues
-static void Hook( const uint64_t M; struct Record* TOP[M], struct Record* BOTM[M], const uint64_t M)
+// steps H3 and H4 that skip empty queues one at a time are replaced by a lookup of the next nonempty queue in the PILE bitmap
+// so the cost of hooking up is proportional to the number of nonempty queues and not to M
+static void Hook(const uint64_t M; struct Record* TOP[M], struct Record* BOTM[M], const uint64_t M, const uint64_t PILE[], const uint64_t PILE_WORD[])
 {
 
 // H1 [Initialize] i <- 0
   uint64_t i = 0;
 
-// loop over M queues starting with queue 0
-// 
+// loop over nonempty queues starting with queue 0
   for(;;) {
 
 // H2 [Point to top of pile] P <- TOP[i]
 // tail of current queue
     struct Record* P = TOP[i];
 
-// skip empty queues
-    do {
-
 // H3 [Next pile] i <- i + 1
-      ++i;
+// H4 [Is pile empty?] To H3 if BOTM[i] = lambda
+// skip all empty queues at once
+    i = find_pile(M, PILE, PILE_WORD, i + 1);
 
 // H3 [Next pile] LINK(P) <- lambda and terminate if i = M
-      if(i == M) {
-        P->LINK = NULL;
-        return;
-      }
-
-// H4 [Is pile empty?] To H3 if BOTM[i] = lambda
-    } while(BOTM[i] == NULL);
+    if(i == M) {
+      P->LINK = NULL;
+      return;
+    }
 
 // H5 [Tie pile together] LINK(P) <- BOTM[i]
 // makes tail node of current queue point to head node of higher indexed nonempty queue
@@ -94,7 +162,7 @@ static void Hook( const uint64_t M; struct Record* TOP[M], struct Record* BOTM[M
 }
 
 // Sort takes array R of N records
-// M is radix or base
+// M is radix or base, a power of 2 from 2^LG_M_MIN to 2^LG_M_MAX
 // p is length of key in base M
 // Sort implements Algorithm R (Radix list sort)
 // R is sorted in place
@@ -104,39 +172,73 @@ struct Record* Sort(const uint64_t N; struct Record R[N + 1], const uint64_t N,
   if(N == 0)
     return NULL;
 
+// digit of key in base M is lgM bits
+  const uint64_t lgM = __builtin_ctzll(M);
+
 // R1 [Loop on k] P <- LOC(R_N)
   struct Record* P = &R[N];
 
-// R1 [Loop on k] Perform R2-R6 for k = 1,2,...,p
-  for(uint64_t k = 1; k <= p; ++k) {
-
-// R2 [Set piles empty]
-
 // queue design follows section 2.2.3 linked allocation pp.259-261
 // node links point from head of queue to rear of queue
 // crucial aspect of empty queue: "the value of variable F must be stored in the LINK field of its location if this idea is to work"
 // this means F or front pointer to an empty queue is used as if it were a node with a LINK field, i.e. cast as struct Record* in our case
 
 // head of queue
-    struct Record* BOTM[M];
+  struct Record* BOTM[M];
 
 // rear of queue where new node enters
-    struct Record* TOP[M];
+  struct Record* TOP[M];
+
+// bitmaps of nonempty piles
+  uint64_t PILE[pile_words(M)];
+  uint64_t PILE_WORD[pile_word_words(M)];
 
 // R2 [Set piles empty] TOP[i] <- LOC(BOTM[i]), BOTM[i] <- lambda for 0 <= i < M
-    for(uint64_t i = 0; i < M; ++i) {
+// all M piles are set empty only once
+// later passes set empty just the piles that the previous pass filled
+  for(uint64_t i = 0; i < M; ++i) {
 
 // empty queue needs BOTM[i] treated as if it were a record node
 // see note above about empty queue design
-      TOP[i] = (void*)&BOTM[i];
-      BOTM[i] = NULL;
+    TOP[i] = (void*)&BOTM[i];
+    BOTM[i] = NULL;
+  }
+
+  memset(PILE, 0, sizeof PILE);
+  memset(PILE_WORD, 0, sizeof PILE_WORD);
+
+// R1 [Loop on k] Perform R2-R6 for k = 1,2,...,p
+  for(uint64_t k = 1; k <= p; ++k) {
+
+// R2 [Set piles empty] TOP[i] <- LOC(BOTM[i]), BOTM[i] <- lambda for piles filled by previous pass
+    if(k > 1) {
+
+// only words marked in PILE_WORD can be nonzero in PILE
+      for(uint64_t s = 0; s < pile_word_words(M); ++s) {
+        for(uint64_t words = PILE_WORD[s]; words != 0; words &= words - 1) {
+
+          const uint64_t w = 64 * s + __builtin_ctzll(words);
+          for(uint64_t bits = PILE[w]; bits != 0; bits &= bits - 1) {
+
+            const uint64_t i = 64 * w + __builtin_ctzll(bits);
+            TOP[i] = (void*)&BOTM[i];
+            BOTM[i] = NULL;
+          }
+
+          PILE[w] = 0;
+        }
+
+        PILE_WORD[s] = 0;
+      }
     }
 
+// position of kth least significant digit in key
+    const uint64_t shift = lgM * (k - 1);
+
     for(;;) {
 
 // R3 [Extract kth digit of key] i <- kth least significant digit of key
-// this assumes base 256 following the mmix implementation, may generalize later
-      const uint8_t i = (P->KEY >> (8 * (k - 1))) & 0xffu;
+      const uint64_t i = (P->KEY >> shift) & (M - 1);
 
 // R4 [Adjust links] LINK(TOP[i] <- P, TOP[i] <- P
 // note TOP[i] is BOTM[i] when queue is empty
@@ -144,6 +246,9 @@ struct Record* Sort(const uint64_t N; struct Record R[N + 1], const uint64_t N,
       TOP[i]->LINK = P;
       TOP[i] = P;
 
+// remember pile i is nonempty for Algorithm H and next R2
+      mark_pile(PILE, PILE_WORD, i);
+
 // R5 [Step to next record] P <- LOC(R_(j - 1) if k = 1 and P = LOC(R_j) for j != 1
       if(k == 1) {
         ptrdiff_t j = P - R;
@@ -167,7 +272,7 @@ struct Record* Sort(const uint64_t N; struct Record R[N + 1], const uint64_t N,
     }
 
 // R6 [Do Algorithm H] Perform Algorithm H
-    Hook(TOP, BOTM, M);
+    Hook(TOP, BOTM, M, PILE, PILE_WORD);
 
 // R6 [Do Algorithm H] P <- BOTM[0]
     P = BOTM[0];
@@ -178,6 +283,50 @@ struct Record* Sort(const uint64_t N; struct Record R[N + 1], const uint64_t N,
 
 }
 
+// number of bits needed for largest key of N records
+static uint64_t KeyBits(const uint64_t N; const struct Record R[N + 1], const uint64_t N)
+{
+
+// OR of all keys has the same highest 1 bit as the largest key
+  uint64_t bits = 0;
+  for(uint64_t i = 1; i <= N; ++i) {
+    bits |= R[i].KEY;
+  }
+
+  return bits == 0 ? 0 : 64 - __builtin_clzll(bits);
+}
+
+// chooses lg M for N keys of b bits
+// a pass costs about N + M so radix M is kept no larger than N
+// the fewest passes p with M no larger than 2^LG_M_AUTO_MAX are chosen
+// then digits are made just wide enough for p passes
+// e.g. 64-bit keys need 5 passes with 13-bit digits instead of 8 passes with 8-bit digits
+static uint64_t ChooseLgM(const uint64_t N, const uint64_t b)
+{
+
+// bits in N
+  const uint64_t lgN = N == 0 ? 0 : 64 - __builtin_clzll(N);
+
+  uint64_t lgM = LG_M_AUTO_MAX;
+  if(lgN < lgM)
+    lgM = lgN;
+  if(lgM < LG_M_MIN)
+    lgM = LG_M_MIN;
+
+  if(b == 0)
+    return lgM;
+
+// fewest passes for digits of lgM bits
+  const uint64_t p = (b + lgM - 1) / lgM;
+
+// narrowest digits for p passes
+  lgM = (b + p - 1) / p;
+  if(lgM < LG_M_MIN)
+    lgM = LG_M_MIN;
+
+  return lgM;
+}
+
 int main(int argc, char* argv[])
 {
 
@@ -192,8 +341,14 @@ int main(int argc, char* argv[])
   uint64_t M;
   fread(&M, sizeof M, 1, stdin);
 
-  if(M != 256) {
-    fprintf(stderr, "Invalid input data: radix M must be 256\n");
+  if(M != 0 && (M & (M - 1)) != 0) {
+    fprintf(stderr, "Invalid input data: radix M must be a power of 2\n");
+    usage();
+    exit(1);
+  }
+
+  if(M != 0 && (M < UINT64_C(1) << LG_M_MIN || M > UINT64_C(1) << LG_M_MAX)) {
+    fprintf(stderr, "Invalid input data: radix M must be from %" PRIu64 " to %" PRIu64 "\n", UINT64_C(1) << LG_M_MIN, UINT64_C(1) << LG_M_MAX);
     usage();
     exit(1);
   }
@@ -214,6 +369,29 @@ int main(int argc, char* argv[])
     fread(&R[i].KEY, sizeof(R[i].KEY), 1, stdin);
   }
 
+// bits in largest key
+  const uint64_t b = KeyBits(R, N);
+
+// choose radix from the data if M = 0
+  if(M == 0) {
+    M = UINT64_C(1) << ChooseLgM(N, b);
+  }
+
+  const uint64_t lgM = __builtin_ctzll(M);
+
+// derive key length from the data if p = 0
+// at least one pass is needed to link records into a list
+  if(p == 0) {
+    p = b == 0 ? 1 : (b + lgM - 1) / lgM;
+  }
+
+// all but the last digit must lie inside the 64-bit key
+  if(p - 1 > 63 / lgM) {
+    fprintf(stderr, "Invalid input data: key length p must be at most %" PRIu64 " digits for radix M = %" PRIu64 "\n", 63 / lgM + 1, M);
+    usage();
+    exit(1);
+  }
+
   const struct Record* const sorted = Sort(R, N, M, p);
 
 // write number of values to follow
@@ -0,0 +1,450 @@
+// algorithm_r_radix_list_sort.compact.c
+
+// Algorithm R (Radix list sort) with 32-bit links
+// 5.2.5 Sorting by Distribution
+// The Art of Computer Programming, Donald Knuth
+// The MMIX Supplement, Martin Ruckert
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+// records are kept in two parallel arrays instead of an array of struct Record
+// LINK[j] is the link of record j as a 32-bit index, KEY[j] is its key
+// a link takes 4 bytes instead of 8 bytes for a pointer
+// so a record takes 12 bytes instead of 16 and a pass moves a quarter less data through the caches
+// index 0 is lambda, records are LINK[1] to LINK[N]
+// LINK[N + 1] to LINK[N + M] play the part of BOTM[0] to BOTM[M - 1]
+// so the empty queue design of Algorithm R works unchanged with TOP[i] = N + 1 + i for an empty pile i
+// N + M must be less than 2^32
+
+// in passes after the first the next record is found by following a link
+// so the key and link of the next record are prefetched while the current record is distributed
+
+// radix M is a power of 2, M = 2^lgM, so a digit is a field of lgM bits in the key
+
+// smallest radix supported is 2^4
+#define LG_M_MIN 4u
+
+// largest radix supported is 2^16
+#define LG_M_MAX 16u
+
+// largest radix chosen automatically is 2^13
+// TOP and BOTM for 2^13 piles take 128KiB and stay in level 2 cache while records stream through
+#define LG_M_AUTO_MAX 13u
+
+
+static void usage()
+{
+  puts("usage:algorithm_r_radix_list_sort.compact <in.dat >out.dat");
+  puts("Implements Algorithm R (Radix list sort) with 32-bit links, 5.2.5 Sorting by Distribution, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
+
+  puts("first uint64_t is base or radix M to use, any power of 2 from 16 to 65536");
+  puts("M = 0 chooses M automatically from number of values and number of bits in the largest value");
+  puts("second uint64_t is length p of values in base M, e.g. p = 2 with M = 256 means values fit into 2 bytes");
+  puts("p = 0 derives p from number of bits in the largest value");
+  puts("third uint64_t is number of values to sort, less than 2^32 - M");
+  puts("next that many int64_t is data to sort");
+
+  puts("");
+  puts("binary input data format");
+  puts("uint64_t M");
+  puts("uint64_t p");
+  puts("uint64_t N");
+  puts("int64_t[N] data");
+
+  puts("");
+  puts("binary output data format");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("examples:");
+  puts("algorithm_r_radix_list_sort.compact <data/algorithm_r_radix_list_sort.compact/in.0.le.dat | od -An -td8 -w8 -v");
+}
+
+// prefetch of data at address for reading
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
+
+// the nonempty piles of a pass are kept in a two-level bitmap
+// bit i of PILE is set when pile i is nonempty
+// bit w of PILE_WORD is set when word w of PILE is nonzero
+// so the nonempty piles are found in order without looking at every one of the M piles
+// PILE has ceil(M/64) words and PILE_WORD has ceil(M/4096) words, at most 1024 and 16 for M = 2^16
+
+// number of 64-bit words in PILE bitmap for M piles
+static uint64_t pile_words(const uint64_t M)
+{
+  return (M + 63) / 64;
+}
+
+// number of 64-bit words in PILE_WORD bitmap for M piles
+static uint64_t pile_word_words(const uint64_t M)
+{
+  return (pile_words(M) + 63) / 64;
+}
+
+// marks pile i nonempty
+static inline void mark_pile(uint64_t PILE[], uint64_t PILE_WORD[], const uint64_t i)
+{
+  PILE[i / 64] |= UINT64_C(1) << (i % 64);
+  PILE_WORD[i / 4096] |= UINT64_C(1) << (i / 64 % 64);
+}
+
+// finds first nonempty pile i >= j, returns M if there is none
+static uint64_t find_pile(const uint64_t M, const uint64_t PILE[], const uint64_t PILE_WORD[], const uint64_t j)
+{
+
+  if(j >= M)
+    return M;
+
+// look for a nonempty pile in the same word as j
+  const uint64_t bits = PILE[j / 64] & (~UINT64_C(0) << (j % 64));
+  if(bits != 0)
+    return j / 64 * 64 + __builtin_ctzll(bits);
+
+// look for the next nonzero word w of PILE
+  const uint64_t w = j / 64 + 1;
+  for(uint64_t s = w / 64; s < pile_word_words(M); ++s) {
+
+    uint64_t words = PILE_WORD[s];
+    if(s == w / 64)
+      words &= ~UINT64_C(0) << (w % 64);
+
+    if(words != 0) {
+      const uint64_t v = 64 * s + __builtin_ctzll(words);
+      return 64 * v + __builtin_ctzll(PILE[v]);
+    }
+  }
+
+  return M;
+}
+
+// implements Algorithm H (Hooking-up of queues) with 32-bit links
+// takes M queues with nodes pointing from head to tail
+// head of each queue is at BOTM[i], which is LINK[N + 1 + i]
+// tail of each queue is at TOP[i]
+// links all M queues together into single queue with tail at BOTM[0] and TOP[0] pointing to a node at BOTM[j] where j > i is the next nonempty queue
+// the case of empty queue 0 is tricky and relies on the special way front and rear pointers are defined for these queues
+// steps H3 and H4 that skip empty queues one at a time are replaced by a lookup of the next nonempty queue in the PILE bitmap
+static void Hook(const uint64_t M; uint32_t LINK[], const uint32_t TOP[M], const uint32_t BOTM[M], const uint64_t M, const uint64_t PILE[], const uint64_t PILE_WORD[])
+{
+
+// H1 [Initialize] i <- 0
+  uint64_t i = 0;
+
+// loop over nonempty queues starting with queue 0
+  for(;;) {
+
+// H2 [Point to top of pile] P <- TOP[i]
+// tail of current queue
+    const uint32_t P = TOP[i];
+
+// H3 [Next pile] i <- i + 1
+// H4 [Is pile empty?] To H3 if BOTM[i] = lambda
+// skip all empty queues at once
+    i = find_pile(M, PILE, PILE_WORD, i + 1);
+
+// H3 [Next pile] LINK(P) <- lambda and terminate if i = M
+    if(i == M) {
+      LINK[P] = 0;
+      return;
+    }
+
+// H5 [Tie pile together] LINK(P) <- BOTM[i]
+// makes tail node of current queue point to head node of higher indexed nonempty queue
+    LINK[P] = BOTM[i];
+
+// H5 [Tie pile together] To H2
+  }
+
+}
+
+// Sort takes arrays LINK of N + M + 1 links and KEY of N + 1 keys for N records
+// M is radix or base, a power of 2 from 2^LG_M_MIN to 2^LG_M_MAX
+// p is length of key in base M
+// N + M must be less than 2^32
+// Sort implements Algorithm R (Radix list sort) with 32-bit links
+// returns index of first record of sorted list, 0 if N = 0
+uint32_t Sort(const uint64_t N, const uint64_t M; uint32_t LINK[N + M + 1], const uint64_t KEY[N + 1], const uint64_t N, const uint64_t M, const uint64_t p)
+{
+
+  if(N == 0)
+    return 0;
+
+// digit of key in base M is lgM bits
+  const uint64_t lgM = __builtin_ctzll(M);
+
+// R1 [Loop on k] P <- LOC(R_N)
+  uint32_t P = N;
+
+// head of queue
+  uint32_t* const BOTM = &LINK[N + 1];
+
+// rear of queue where new node enters
+  uint32_t TOP[M];
+
+// bitmaps of nonempty piles
+  uint64_t PILE[pile_words(M)];
+  uint64_t PILE_WORD[pile_word_words(M)];
+
+// R2 [Set piles empty] TOP[i] <- LOC(BOTM[i]), BOTM[i] <- lambda for 0 <= i < M
+// all M piles are set empty only once
+// later passes set empty just the piles that the previous pass filled
+  for(uint64_t i = 0; i < M; ++i) {
+    TOP[i] = N + 1 + i;
+    BOTM[i] = 0;
+  }
+
+  memset(PILE, 0, sizeof PILE);
+  memset(PILE_WORD, 0, sizeof PILE_WORD);
+
+// R1 [Loop on k] Perform R2-R6 for k = 1,2,...,p
+  for(uint64_t k = 1; k <= p; ++k) {
+
+// R2 [Set piles empty] TOP[i] <- LOC(BOTM[i]), BOTM[i] <- lambda for piles filled by previous pass
+    if(k > 1) {
+
+// only words marked in PILE_WORD can be nonzero in PILE
+      for(uint64_t s = 0; s < pile_word_words(M); ++s) {
+        for(uint64_t words = PILE_WORD[s]; words != 0; words &= words - 1) {
+
+          const uint64_t w = 64 * s + __builtin_ctzll(words);
+          for(uint64_t bits = PILE[w]; bits != 0; bits &= bits - 1) {
+
+            const uint64_t i = 64 * w + __builtin_ctzll(bits);
+            TOP[i] = N + 1 + i;
+            BOTM[i] = 0;
+          }
+
+          PILE[w] = 0;
+        }
+
+        PILE_WORD[s] = 0;
+      }
+    }
+
+// position of kth least significant digit in key
+    const uint64_t shift = lgM * (k - 1);
+
+// first pass steps through records in order R_N, R_(N - 1),..., R_1
+    if(k == 1) {
+
+      for(;;) {
+
+// R3 [Extract kth digit of key] i <- kth least significant digit of key
+        const uint64_t i = (KEY[P] >> shift) & (M - 1);
+
+// R4 [Adjust links] LINK(TOP[i] <- P, TOP[i] <- P
+        LINK[TOP[i]] = P;
+        TOP[i] = P;
+
+// remember pile i is nonempty for Algorithm H and next R2
+        mark_pile(PILE, PILE_WORD, i);
+
+// R5 [Step to next record] P <- LOC(R_(j - 1) if k = 1 and P = LOC(R_j) for j != 1
+        if(P == 1)
+          break;
+
+        --P;
+      }
+
+    }
+
+// later passes step through records by following links
+    if(k > 1) {
+
+      for(;;) {
+
+// next record is not touched by R4 for this record so its link is already final
+        const uint32_t Q = LINK[P];
+
+// prefetch next record while this one is distributed
+        PREFETCH(&KEY[Q]);
+        PREFETCH(&LINK[Q]);
+
+// R3 [Extract kth digit of key] i <- kth least significant digit of key
+        const uint64_t i = (KEY[P] >> shift) & (M - 1);
+
+// R4 [Adjust links] LINK(TOP[i] <- P, TOP[i] <- P
+        LINK[TOP[i]] = P;
+        TOP[i] = P;
+
+// remember pile i is nonempty for Algorithm H and next R2
+        mark_pile(PILE, PILE_WORD, i);
+
+// R5 [Step to next record] P <- LINK(P) if k > 1
+        P = Q;
+
+// R5 [Step to next record] To R3 if P != lambda
+        if(P == 0)
+          break;
+      }
+
+    }
+
+// R6 [Do Algorithm H] Perform Algorithm H
+    Hook(LINK, TOP, BOTM, M, PILE, PILE_WORD);
+
+// R6 [Do Algorithm H] P <- BOTM[0]
+    P = BOTM[0];
+
+  }
+
+  return P;
+
+}
+
+// number of bits needed for largest of N keys
+static uint64_t KeyBits(const uint64_t N, const uint64_t KEY[N + 1])
+{
+
+// OR of all keys has the same highest 1 bit as the largest key
+  uint64_t bits = 0;
+  for(uint64_t i = 1; i <= N; ++i) {
+    bits |= KEY[i];
+  }
+
+  return bits == 0 ? 0 : 64 - __builtin_clzll(bits);
+}
+
+// chooses lg M for N keys of b bits
+// a pass costs about N + M so radix M is kept no larger than N
+// the fewest passes p with M no larger than 2^LG_M_AUTO_MAX are chosen
+// then digits are made just wide enough for p passes
+// e.g. 64-bit keys need 5 passes with 13-bit digits instead of 8 passes with 8-bit digits
+static uint64_t ChooseLgM(const uint64_t N, const uint64_t b)
+{
+
+// bits in N
+  const uint64_t lgN = N == 0 ? 0 : 64 - __builtin_clzll(N);
+
+  uint64_t lgM = LG_M_AUTO_MAX;
+  if(lgN < lgM)
+    lgM = lgN;
+  if(lgM < LG_M_MIN)
+    lgM = LG_M_MIN;
+
+  if(b == 0)
+    return lgM;
+
+// fewest passes for digits of lgM bits
+  const uint64_t p = (b + lgM - 1) / lgM;
+
+// narrowest digits for p passes
+  lgM = (b + p - 1) / p;
+  if(lgM < LG_M_MIN)
+    lgM = LG_M_MIN;
+
+  return lgM;
+}
+
+int main(int argc, char* argv[])
+{
+
+  (void)argv;
+
+  if(argc > 1) {
+    usage();
+    exit(0);
+  }
+
+// M is radix
+  uint64_t M;
+  fread(&M, sizeof M, 1, stdin);
+
+  if(M != 0 && (M & (M - 1)) != 0) {
+    fprintf(stderr, "Invalid input data: radix M must be a power of 2\n");
+    usage();
+    exit(1);
+  }
+
+  if(M != 0 && (M < UINT64_C(1) << LG_M_MIN || M > UINT64_C(1) << LG_M_MAX)) {
+    fprintf(stderr, "Invalid input data: radix M must be from %" PRIu64 " to %" PRIu64 "\n", UINT64_C(1) << LG_M_MIN, UINT64_C(1) << LG_M_MAX);
+    usage();
+    exit(1);
+  }
+
+// p is key length in base M
+  uint64_t p;
+  fread(&p, sizeof p, 1, stdin);
+
+// read 64-bit size of data array as binary data
+  uint64_t N;
+  fread(&N, sizeof N, 1, stdin);
+
+// links need 32 bits for N records and M pile heads
+  if(N >= (UINT64_C(1) << 32) - (UINT64_C(1) << LG_M_MAX)) {
+    fprintf(stderr, "Invalid input data: number of values N must be less than %" PRIu64 "\n", (UINT64_C(1) << 32) - (UINT64_C(1) << LG_M_MAX));
+    usage();
+    exit(1);
+  }
+
+// read array KEY of keys as binary data
+// arrays of links and keys are too big for the stack when N is large
+  uint64_t* KEY = malloc((N + 1) * sizeof(*KEY));
+
+  if(KEY == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  fread(&KEY[1], sizeof(*KEY), N, stdin);
+
+// bits in largest key
+  const uint64_t b = KeyBits(N, KEY);
+
+// choose radix from the data if M = 0
+  if(M == 0) {
+    M = UINT64_C(1) << ChooseLgM(N, b);
+  }
+
+  const uint64_t lgM = __builtin_ctzll(M);
+
+// derive key length from the data if p = 0
+// at least one pass is needed to link records into a list
+  if(p == 0) {
+    p = b == 0 ? 1 : (b + lgM - 1) / lgM;
+  }
+
+// all but the last digit must lie inside the 64-bit key
+  if(p - 1 > 63 / lgM) {
+    fprintf(stderr, "Invalid input data: key length p must be at most %" PRIu64 " digits for radix M = %" PRIu64 "\n", 63 / lgM + 1, M);
+    usage();
+    exit(1);
+  }
+
+// array LINK of links for N records and M pile heads
+  uint32_t* LINK = malloc((N + M + 1) * sizeof(*LINK));
+
+  if(LINK == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  const uint32_t sorted = Sort(LINK, KEY, N, M, p);
+
+// write number of values to follow
+  fwrite(&N, sizeof N, 1, stdout);
+
+// traverse linked list to print sorted keys as binary data
+  for(uint32_t j = sorted; j != 0; j = LINK[j]) {
+    fwrite(&KEY[j], sizeof(KEY[j]), 1, stdout);
+  }
+
+  free(LINK);
+  free(KEY);
+
+  return 0;
+}
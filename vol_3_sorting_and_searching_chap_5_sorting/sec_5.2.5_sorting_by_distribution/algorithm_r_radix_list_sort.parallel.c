@@ -0,0 +1,459 @@
+// algorithm_r_radix_list_sort.parallel.c
+
+// Algorithm R (Radix list sort) on arrays with multiple threads
+// 5.2.5 Sorting by Distribution
+// The Art of Computer Programming, Donald Knuth
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <threads.h>
+#include <unistd.h>
+
+// parallel version of algorithm_r_radix_list_sort.array
+// the keys are split into T consecutive slices, one per thread
+// in each pass every thread counts the digits of the keys in its own slice
+// then pile i of the destination array is split into T consecutive areas
+// one for the keys with digit i from each slice, in order of the slices
+// so the offset of the area for thread t in pile i is the prefix sum of the counts
+// for all smaller digits from all threads plus the counts for digit i from threads before t
+// every thread then moves the keys of its slice into its own areas without any locking
+// keys with equal digits keep their order within a slice and slices keep their order within a pile
+// so the sort is stable and the output does not depend on the number of threads or their timing
+// and is identical to algorithm_r_radix_list_sort
+
+// counts for all p digits over the whole array are found first in parallel
+// to skip passes where all N keys have the same digit
+// the first pass that moves keys reuses those per-thread counts since no key has moved yet
+
+// radix M is a power of 2, M = 2^lgM, so a digit is a field of lgM bits in the key
+
+// smallest radix supported is 2^4
+#define LG_M_MIN 4u
+
+// largest radix supported is 2^16
+#define LG_M_MAX 16u
+
+// largest radix chosen automatically is 2^13
+// counts for 2^13 piles take 64KiB per thread and stay in level 2 cache while keys stream through
+#define LG_M_AUTO_MAX 13u
+
+// most threads supported
+// keys of 64 bits have at most 4 digits in radix 2^LG_M_MAX so the counts for all threads
+// take T * p * M <= 2^28 entries and the size cannot overflow
+#define THREADS_MAX 1024u
+
+static void usage()
+{
+  puts("usage:algorithm_r_radix_list_sort.parallel [-t threads] <in.dat >out.dat");
+  puts("Implements Algorithm R (Radix list sort) with arrays and multiple threads, 5.2.5 Sorting by Distribution, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads 64-bit values as binary data to sort, outputs sorted 64-bit values as binary data");
+
+  puts("-t: number of threads from 1 to 1024, default is number of online processors");
+
+  puts("first uint64_t is base or radix M to use, any power of 2 from 16 to 65536");
+  puts("M = 0 chooses M automatically from number of values and number of bits in the largest value");
+  puts("second uint64_t is length p of values in base M, e.g. p = 2 with M = 256 means values fit into 2 bytes");
+  puts("p = 0 derives p from number of bits in the largest value");
+  puts("third uint64_t is number of values to sort");
+  puts("next that many int64_t is data to sort");
+
+  puts("");
+  puts("binary input data format");
+  puts("uint64_t M");
+  puts("uint64_t p");
+  puts("uint64_t N");
+  puts("int64_t[N] data");
+
+  puts("");
+  puts("binary output data format");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("examples:");
+  puts("algorithm_r_radix_list_sort.parallel -t 4 <data/algorithm_r_radix_list_sort.parallel/in.0.le.dat | od -An -td8 -w8 -v");
+}
+
+// work of one thread in one phase of the sort
+struct Slice {
+
+// slice of source array is src[first] to src[last - 1]
+  const uint64_t* src;
+  uint64_t first;
+  uint64_t last;
+
+// destination array
+  uint64_t* dst;
+
+// radix and shift of first digit to count or distribute
+  uint64_t M;
+  uint64_t shift;
+
+// number of digits to count
+  uint64_t p;
+
+// counts of digits in slice for p digits, p * M entries
+// turned into offsets of this slice's areas in destination piles before distributing
+  uint64_t* COUNT;
+};
+
+// Count fills COUNT[k][i] with number of keys in slice whose (k + 1)th digit counting from shift is i
+// for p digits at once
+static int Count(void* arg)
+{
+
+  const struct Slice* const slice = arg;
+
+  const uint64_t* const src = slice->src;
+  const uint64_t M = slice->M;
+  const uint64_t lgM = __builtin_ctzll(M);
+  const uint64_t p = slice->p;
+  uint64_t* const COUNT = slice->COUNT;
+
+  memset(COUNT, 0, p * M * sizeof(*COUNT));
+
+  for(uint64_t j = slice->first; j < slice->last; ++j) {
+
+    const uint64_t key = src[j] >> slice->shift;
+
+    for(uint64_t k = 0; k < p; ++k) {
+      ++COUNT[k * M + ((key >> (lgM * k)) & (M - 1))];
+    }
+  }
+
+  return 0;
+}
+
+// Distribute moves keys of slice to the tops of their piles in destination array
+// COUNT holds offsets of this slice's areas in the M piles
+static int Distribute(void* arg)
+{
+
+  const struct Slice* const slice = arg;
+
+  const uint64_t* const src = slice->src;
+  uint64_t* const dst = slice->dst;
+  const uint64_t M = slice->M;
+  const uint64_t shift = slice->shift;
+  uint64_t* const TOP = slice->COUNT;
+
+  for(uint64_t j = slice->first; j < slice->last; ++j) {
+    const uint64_t key = src[j];
+    dst[TOP[(key >> shift) & (M - 1)]++] = key;
+  }
+
+  return 0;
+}
+
+// runs phase on T threads, one for each slice
+static void Run(const uint64_t T, struct Slice slice[T], thrd_t thread[T], thrd_start_t phase)
+{
+
+// slice 0 runs on the calling thread
+  for(uint64_t t = 1; t < T; ++t) {
+    if(thrd_create(&thread[t], phase, &slice[t]) != thrd_success) {
+      fprintf(stderr, "error: thrd_create failure\n");
+      exit(2);
+    }
+  }
+
+  phase(&slice[0]);
+
+  for(uint64_t t = 1; t < T; ++t) {
+    thrd_join(thread[t], NULL);
+  }
+
+}
+
+// Sort takes array K of N keys beginning at K[1] and workspace array W of N + 1 keys
+// M is radix or base, a power of 2 from 2^LG_M_MIN to 2^LG_M_MAX
+// p is length of key in base M
+// T is number of threads
+// Sort implements Algorithm R (Radix list sort) with arrays on T threads
+// returns K or W, whichever holds the sorted keys beginning at index 1
+uint64_t* Sort(const uint64_t N, uint64_t K[N + 1], uint64_t W[N + 1], const uint64_t M, const uint64_t p, uint64_t T)
+{
+
+  if(N == 0)
+    return K;
+
+// no thread gets an empty slice
+  if(T > N)
+    T = N;
+
+  const uint64_t lgM = __builtin_ctzll(M);
+
+// counts of each digit in each slice for all p digits
+  uint64_t* COUNT = malloc(T * p * M * sizeof(*COUNT));
+
+// slices, their threads and their counts of kth digit
+  struct Slice* slice = malloc(T * sizeof(*slice));
+  thrd_t* thread = malloc(T * sizeof(*thread));
+  uint64_t** TOP = malloc(T * sizeof(*TOP));
+
+  if(COUNT == NULL || slice == NULL || thread == NULL || TOP == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  for(uint64_t t = 0; t < T; ++t) {
+    slice[t] = (struct Slice){
+      .src = K,
+      .first = 1 + t * N / T,
+      .last = 1 + (t + 1) * N / T,
+      .dst = W,
+      .M = M,
+      .shift = 0,
+      .p = p,
+      .COUNT = &COUNT[t * p * M],
+    };
+  }
+
+// count all p digits of every slice
+  Run(T, slice, thread, Count);
+
+// source and destination arrays switch roles after every pass that moves keys
+  uint64_t* src = K;
+  uint64_t* dst = W;
+
+// true till the first pass that moves keys, the counts of all p digits still match the slices
+  bool unmoved = true;
+
+// loop on k like R1, perform a distribution pass for k = 1,2,...,p
+  for(uint64_t k = 1; k <= p; ++k) {
+
+// position of kth least significant digit in key
+    const uint64_t shift = lgM * (k - 1);
+    const uint64_t digit = (src[1] >> shift) & (M - 1);
+
+// skip pass if one pile would hold every key
+// only the initial counts are for all digits of the whole array
+    if(unmoved) {
+      uint64_t total = 0;
+      for(uint64_t t = 0; t < T; ++t) {
+        total += slice[t].COUNT[(k - 1) * M + digit];
+      }
+      if(total == N)
+        continue;
+    }
+
+// counts of kth digit for each slice
+    for(uint64_t t = 0; t < T; ++t) {
+      slice[t].src = src;
+      slice[t].dst = dst;
+      slice[t].shift = shift;
+      TOP[t] = &slice[t].COUNT[unmoved ? (k - 1) * M : 0];
+    }
+
+// count kth digit of every slice now that keys have moved
+    if(!unmoved) {
+      for(uint64_t t = 0; t < T; ++t) {
+        slice[t].p = 1;
+      }
+      Run(T, slice, thread, Count);
+
+// skip pass if one pile would hold every key
+      uint64_t total = 0;
+      for(uint64_t t = 0; t < T; ++t) {
+        total += TOP[t][digit];
+      }
+      if(total == N)
+        continue;
+    }
+
+// set piles empty like R2
+// area for slice t in pile i begins after piles for all smaller digits
+// and after areas for slices before t in pile i
+    for(uint64_t i = 0, sum = 1; i < M; ++i) {
+      for(uint64_t t = 0; t < T; ++t) {
+        const uint64_t count = TOP[t][i];
+        TOP[t][i] = sum;
+        sum += count;
+      }
+    }
+
+// distribute pass offsets from TOP
+    for(uint64_t t = 0; t < T; ++t) {
+      slice[t].COUNT = TOP[t];
+    }
+
+// extract kth digit of key like R3 and add record to top of its pile like R4
+// every thread steps through its own slice like R5
+    Run(T, slice, thread, Distribute);
+
+// restore per-thread count arrays
+    for(uint64_t t = 0; t < T; ++t) {
+      slice[t].COUNT = &COUNT[t * p * M];
+    }
+
+// piles are already hooked together like R6 since they are consecutive in destination array
+    uint64_t* tmp = src;
+    src = dst;
+    dst = tmp;
+
+    unmoved = false;
+
+  }
+
+  free(TOP);
+  free(thread);
+  free(slice);
+  free(COUNT);
+
+  return src;
+
+}
+
+// number of bits needed for largest of N keys
+static uint64_t KeyBits(const uint64_t N, const uint64_t K[N + 1])
+{
+
+// OR of all keys has the same highest 1 bit as the largest key
+  uint64_t bits = 0;
+  for(uint64_t i = 1; i <= N; ++i) {
+    bits |= K[i];
+  }
+
+  return bits == 0 ? 0 : 64 - __builtin_clzll(bits);
+}
+
+// chooses lg M for N keys of b bits
+// a pass costs about N + M so radix M is kept no larger than N
+// the fewest passes p with M no larger than 2^LG_M_AUTO_MAX are chosen
+// then digits are made just wide enough for p passes
+static uint64_t ChooseLgM(const uint64_t N, const uint64_t b)
+{
+
+// bits in N
+  const uint64_t lgN = N == 0 ? 0 : 64 - __builtin_clzll(N);
+
+  uint64_t lgM = LG_M_AUTO_MAX;
+  if(lgN < lgM)
+    lgM = lgN;
+  if(lgM < LG_M_MIN)
+    lgM = LG_M_MIN;
+
+  if(b == 0)
+    return lgM;
+
+// fewest passes for digits of lgM bits
+  const uint64_t p = (b + lgM - 1) / lgM;
+
+// narrowest digits for p passes
+  lgM = (b + p - 1) / p;
+  if(lgM < LG_M_MIN)
+    lgM = LG_M_MIN;
+
+  return lgM;
+}
+
+int main(int argc, char* argv[])
+{
+
+// number of threads
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  uint64_t T = online <= 0 ? 1 : (uint64_t)online < THREADS_MAX ? (uint64_t)online : THREADS_MAX;
+
+  for(int opt; (opt = getopt(argc, argv, "ht:")) != -1;) {
+    switch(opt) {
+      case 't':
+        T = strtoull(optarg, NULL, 10);
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind < argc) {
+    usage();
+    exit(1);
+  }
+
+  if(T == 0 || T > THREADS_MAX) {
+    fprintf(stderr, "Invalid input data: number of threads T must be from 1 to %u\n", THREADS_MAX);
+    usage();
+    exit(1);
+  }
+
+// M is radix
+  uint64_t M;
+  fread(&M, sizeof M, 1, stdin);
+
+  if(M != 0 && (M & (M - 1)) != 0) {
+    fprintf(stderr, "Invalid input data: radix M must be a power of 2\n");
+    usage();
+    exit(1);
+  }
+
+  if(M != 0 && (M < UINT64_C(1) << LG_M_MIN || M > UINT64_C(1) << LG_M_MAX)) {
+    fprintf(stderr, "Invalid input data: radix M must be from %" PRIu64 " to %" PRIu64 "\n", UINT64_C(1) << LG_M_MIN, UINT64_C(1) << LG_M_MAX);
+    usage();
+    exit(1);
+  }
+
+// p is key length in base M
+  uint64_t p;
+  fread(&p, sizeof p, 1, stdin);
+
+// read 64-bit size of data array as binary data
+  uint64_t N;
+  fread(&N, sizeof N, 1, stdin);
+
+// arrays of keys and workspace are too big for the stack when N is large
+// allocate N+1 entries to use array indexing from 1 instead of 0
+  uint64_t* K = malloc((N + 1) * sizeof(*K));
+  uint64_t* W = malloc((N + 1) * sizeof(*W));
+
+  if(K == NULL || W == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+// read array K of keys as binary data
+  fread(&K[1], sizeof(*K), N, stdin);
+
+// bits in largest key
+  const uint64_t b = KeyBits(N, K);
+
+// choose radix from the data if M = 0
+  if(M == 0) {
+    M = UINT64_C(1) << ChooseLgM(N, b);
+  }
+
+  const uint64_t lgM = __builtin_ctzll(M);
+
+// derive key length from the data if p = 0
+  if(p == 0) {
+    p = b == 0 ? 1 : (b + lgM - 1) / lgM;
+  }
+
+// all but the last digit must lie inside the 64-bit key
+  if(p - 1 > 63 / lgM) {
+    fprintf(stderr, "Invalid input data: key length p must be at most %" PRIu64 " digits for radix M = %" PRIu64 "\n", 63 / lgM + 1, M);
+    usage();
+    exit(1);
+  }
+
+  const uint64_t* const sorted = Sort(N, K, W, M, p, T);
+
+// write number of values to follow
+  fwrite(&N, sizeof N, 1, stdout);
+
+// print sorted array as binary data
+  fwrite(&sorted[1], sizeof(*sorted), N, stdout);
+
+  free(W);
+  free(K);
+
+  return 0;
+}
@@ -0,0 +1,376 @@
+// algorithm_r_radix_list_sort.strings.c
+
+// Algorithm R (Radix list sort) for variable-length strings, most significant digit first
+// 5.2.5 Sorting by Distribution
+// The Art of Computer Programming, Donald Knuth
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+// keys are strings of bytes of any length compared in lexicographic order
+// a string that is a prefix of another string comes first
+// a byte of the key is a digit in base 256
+// keys have different lengths so a least significant digit does not make sense
+// and the piles are formed on the most significant digit first as suggested in 5.2.5
+// the records of a pile are then sorted on the next digit separately from all other piles
+
+// one distribution is steps R2-R5 of Algorithm R on the byte at position d of the key
+// the d bytes before it are equal for all records of the pile being distributed and are never looked at again
+// there are M = 257 piles, pile 0 holds keys of length d that have no byte at position d
+// and pile i + 1 holds keys with byte i at position d
+// pile 0 is already sorted since its keys are all equal
+// piles are sorted in turn from a stack instead of being hooked together with Algorithm H
+// the stack holds piles still to be sorted with the first pile on top
+// so sorted piles are appended to the output list in order
+// when all keys of a pile go to the same pile the distribution is just repeated on the next byte
+
+// small piles are sorted with list insertion like Algorithm 5.2.1L
+// comparisons start at byte d since earlier bytes of keys in the pile are known to be equal
+// so a long prefix shared by keys, as in URLs, is not compared over and over
+
+// every step keeps records with equal keys in their original order so the sort is stable
+
+// number of piles for one byte plus pile 0 for end of key
+#define M 257u
+
+// piles with at most this many records are sorted by list insertion
+#define SMALL_PILE 16u
+
+
+static void usage()
+{
+  puts("usage:algorithm_r_radix_list_sort.strings <in.dat >out.dat");
+  puts("Implements Algorithm R (Radix list sort) for strings, most significant digit first, 5.2.5 Sorting by Distribution, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads strings of bytes as binary data to sort, outputs sorted strings as binary data");
+
+  puts("first uint64_t is number of strings to sort");
+  puts("each string is a uint64_t length followed by that many bytes");
+
+  puts("");
+  puts("binary input data format");
+  puts("uint64_t N");
+  puts("N times:");
+  puts("uint64_t length");
+  puts("uint8_t[length] string");
+
+  puts("");
+  puts("binary output data format");
+  puts("uint64_t N");
+  puts("N times:");
+  puts("uint64_t length");
+  puts("uint8_t[length] sorted string");
+
+  puts("");
+  puts("examples:");
+  puts("algorithm_r_radix_list_sort.strings <data/algorithm_r_radix_list_sort.strings/in.0.le.dat | od -An -c");
+}
+
+struct Record {
+// link field, must be first for queues to work
+  struct Record* LINK;
+// length of key in bytes
+  uint64_t LENGTH;
+// bytes of key
+  const uint8_t* KEY;
+};
+
+// pile of records still to be sorted
+struct Pile {
+// first record of pile
+  struct Record* BOTM;
+// number of records in pile
+  uint64_t COUNT;
+// number of leading bytes known to be equal for all keys in pile
+  uint64_t d;
+};
+
+// compares keys of records P and Q starting at byte d
+// returns negative, zero or positive like memcmp
+static int compare(const struct Record* P, const struct Record* Q, const uint64_t d)
+{
+
+  const uint64_t length = P->LENGTH < Q->LENGTH ? P->LENGTH : Q->LENGTH;
+
+  const int c = memcmp(P->KEY + d, Q->KEY + d, length - d);
+  if(c != 0)
+    return c;
+
+  return (P->LENGTH > Q->LENGTH) - (P->LENGTH < Q->LENGTH);
+}
+
+// sorts list of records beginning at P by list insertion like Algorithm 5.2.1L
+// keys are compared from byte d onward
+// a record is inserted after all records with equal keys so the sort is stable
+// returns first record of sorted list, last record of sorted list in *tail
+static struct Record* insertion(struct Record* P, const uint64_t d, struct Record** tail)
+{
+
+// head of sorted list as a dummy record whose LINK field is the first record
+  struct Record head = {NULL, 0, NULL};
+
+  while(P != NULL) {
+
+    struct Record* const next = P->LINK;
+
+// find q, the last record in the sorted list with key <= key of P
+    struct Record* q = &head;
+    while(q->LINK != NULL && compare(q->LINK, P, d) <= 0) {
+      q = q->LINK;
+    }
+
+// insert P after q
+    P->LINK = q->LINK;
+    q->LINK = P;
+
+    P = next;
+  }
+
+  struct Record* last = &head;
+  while(last->LINK != NULL) {
+    last = last->LINK;
+  }
+  *tail = last;
+
+  return head.LINK;
+}
+
+// Sort takes array R of N records beginning at R[1]
+// Sort implements Algorithm R (Radix list sort) for strings, most significant digit first
+// returns first record of the sorted list
+struct Record* Sort(const uint64_t N; struct Record R[N + 1], const uint64_t N)
+{
+
+  if(N == 0)
+    return NULL;
+
+// link records in their original order into a single pile
+  for(uint64_t j = 1; j < N; ++j) {
+    R[j].LINK = &R[j + 1];
+  }
+  R[N].LINK = NULL;
+
+// output list of sorted records, head is a dummy record whose LINK field is the first record
+  struct Record head = {NULL, 0, NULL};
+  struct Record* tail = &head;
+
+// stack of piles to sort, grows as needed
+  uint64_t STACK_MAX = M;
+  uint64_t STACK_SIZE = 0;
+  struct Pile* stack = malloc(STACK_MAX * sizeof(*stack));
+
+  if(stack == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  stack[STACK_SIZE++] = (struct Pile){&R[1], N, 0};
+
+// head of queue
+  struct Record* BOTM[M];
+
+// rear of queue where new node enters
+  struct Record* TOP[M];
+
+// number of records in each queue
+  uint64_t COUNT[M];
+
+  while(STACK_SIZE > 0) {
+
+    const struct Pile pile = stack[--STACK_SIZE];
+
+    struct Record* P = pile.BOTM;
+    uint64_t d = pile.d;
+
+// pile with a single record is sorted
+    if(pile.COUNT == 1) {
+      tail->LINK = P;
+      tail = P;
+      continue;
+    }
+
+// small pile is sorted by list insertion
+    if(pile.COUNT <= SMALL_PILE) {
+      struct Record* last;
+      tail->LINK = insertion(P, d, &last);
+      tail = last;
+      continue;
+    }
+
+// distribute on byte d, repeated on next byte while all records go to the same pile
+    uint64_t nonempty;
+
+    do {
+
+// R2 [Set piles empty] TOP[i] <- LOC(BOTM[i]), BOTM[i] <- lambda for 0 <= i < M
+      for(uint64_t i = 0; i < M; ++i) {
+        TOP[i] = (void*)&BOTM[i];
+        BOTM[i] = NULL;
+        COUNT[i] = 0;
+      }
+
+      nonempty = 0;
+
+      while(P != NULL) {
+
+        struct Record* const next = P->LINK;
+
+// R3 [Extract digit of key] i <- byte d of key plus 1, or 0 if key has no byte d
+        const uint64_t i = d < P->LENGTH ? P->KEY[d] + 1u : 0;
+
+// R4 [Adjust links] LINK(TOP[i]) <- P, TOP[i] <- P
+        TOP[i]->LINK = P;
+        TOP[i] = P;
+
+        if(COUNT[i]++ == 0)
+          ++nonempty;
+
+// R5 [Step to next record] P <- LINK(P), to R3 if P != lambda
+        P = next;
+      }
+
+// terminate each pile
+      for(uint64_t i = 0; i < M; ++i) {
+        if(BOTM[i] != NULL)
+          TOP[i]->LINK = NULL;
+      }
+
+// all keys went to one pile i > 0 so they agree on byte d too
+      if(nonempty == 1 && COUNT[0] == 0) {
+        uint64_t i = 1;
+        while(BOTM[i] == NULL) {
+          ++i;
+        }
+        P = BOTM[i];
+        ++d;
+      }
+
+    } while(nonempty == 1 && COUNT[0] == 0);
+
+// pile 0 holds equal keys of length d in original order and goes straight to output
+    if(BOTM[0] != NULL) {
+      tail->LINK = BOTM[0];
+      tail = TOP[0];
+    }
+
+// push remaining piles with the first pile on top of the stack
+    if(STACK_SIZE + M > STACK_MAX) {
+      STACK_MAX = 2 * (STACK_SIZE + M);
+      stack = realloc(stack, STACK_MAX * sizeof(*stack));
+
+      if(stack == NULL) {
+        fprintf(stderr, "error: realloc failure\n");
+        exit(2);
+      }
+    }
+
+    for(uint64_t i = M - 1; i >= 1; --i) {
+      if(BOTM[i] != NULL) {
+        stack[STACK_SIZE++] = (struct Pile){BOTM[i], COUNT[i], d + 1};
+      }
+    }
+
+  }
+
+  free(stack);
+
+  tail->LINK = NULL;
+
+  return head.LINK;
+
+}
+
+int main(int argc, char* argv[])
+{
+
+  (void)argv;
+
+  if(argc > 1) {
+    usage();
+    exit(0);
+  }
+
+// read 64-bit number of strings as binary data
+  uint64_t N;
+  fread(&N, sizeof N, 1, stdin);
+
+// arrays of records and keys are too big for the stack when N is large
+// allocate N+1 entries to use array indexing from 1 instead of 0
+  struct Record* R = malloc((N + 1) * sizeof(*R));
+
+  if(R == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+// rest of input with all lengths and keys is read into a single buffer that grows as needed
+// keys of records point into the buffer
+  uint64_t size = 0;
+  uint64_t capacity = 4096;
+  uint8_t* bytes = malloc(capacity);
+
+  if(bytes == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  for(;;) {
+
+    size += fread(&bytes[size], 1, capacity - size, stdin);
+    if(size < capacity)
+      break;
+
+    capacity *= 2;
+    bytes = realloc(bytes, capacity);
+
+    if(bytes == NULL) {
+      fprintf(stderr, "error: realloc failure\n");
+      exit(2);
+    }
+  }
+
+// offset of next length in buffer
+  uint64_t offset = 0;
+
+  for(uint64_t j = 1; j <= N; ++j) {
+
+    uint64_t length;
+    if(size - offset < sizeof length) {
+      fprintf(stderr, "Invalid input data: only %" PRIu64 " of %" PRIu64 " strings\n", j - 1, N);
+      exit(1);
+    }
+
+    memcpy(&length, &bytes[offset], sizeof length);
+    offset += sizeof length;
+
+    if(size - offset < length) {
+      fprintf(stderr, "Invalid input data: string %" PRIu64 " is shorter than its length %" PRIu64 "\n", j, length);
+      exit(1);
+    }
+
+    R[j].LENGTH = length;
+    R[j].KEY = &bytes[offset];
+    offset += length;
+  }
+
+  const struct Record* const sorted = Sort(R, N);
+
+// write number of strings to follow
+  fwrite(&N, sizeof N, 1, stdout);
+
+// traverse linked list to print sorted strings as binary data
+  for(const struct Record* p = sorted; p != NULL; p = p->LINK) {
+    fwrite(&p->LENGTH, sizeof(p->LENGTH), 1, stdout);
+    fwrite(p->KEY, 1, p->LENGTH, stdout);
+  }
+
+  free(bytes);
+  free(R);
+
+  return 0;
+}
@@ -0,0 +1,302 @@
+// algorithm_r_replacement_selection.c
+
+// Algorithm R (Replacement selection)
+// 5.4.1 Multiway Merging and Replacement Selection
+// The Art of Computer Programming, Donald Knuth
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+// input of any length streams through a tree of losers holding P records
+// each record output is replaced by the next record of the input
+// a new record smaller than the last key output cannot join the current run, it is tagged for the next run
+// the run number is compared before the key, so the tree keeps giving the current run till it is used up
+// on random input runs average 2P records, twice as long as sorting and writing out P records at a time
+
+// runs are written to files prefix.1.dat, prefix.2.dat, ... in the format read by multiway_merge
+// only P records and two buffers are in memory no matter how long the input is
+
+// default number of records in the tree
+#define P_RECORDS (UINT64_C(1) << 20)
+
+// number of keys in input and output buffers
+#define BUFFER_KEYS (UINT64_C(1) << 16)
+
+static void usage()
+{
+  puts("usage:algorithm_r_replacement_selection [-P records] [-o prefix] <in.dat");
+  puts("Implements Algorithm R (Replacement selection), 5.4.1 Multiway Merging and Replacement Selection, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads 64-bit values as binary data, writes sorted runs of 64-bit values as binary data to files");
+  puts("prints the name and number of keys of each run file");
+
+  puts("");
+  puts("binary input data format");
+  puts("uint64_t N, can be 0 for empty input");
+  puts("int64_t[N] data");
+
+  puts("");
+  puts("binary output data format of each run file");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("-P: number of records in the tree, at least 2, default is 1048576");
+  puts("-o: prefix of run file names, default is run, runs go to run.1.dat, run.2.dat, ...");
+
+  puts("");
+  puts("examples:");
+  puts("algorithm_r_replacement_selection -P 4 -o /tmp/run <data/algorithm_r_replacement_selection/in.1.le.dat");
+  puts("algorithm_r_replacement_selection -o /tmp/run <big.dat && multiway_merge /tmp/run.*.dat >sorted.dat");
+}
+
+// node X[j] of the tree holds a record and the loser of the match at X[j]
+// PE(X[j]) = X[floor((P + j) / 2)] and PI(X[j]) = X[floor(j / 2)] are computed, not stored
+struct Node {
+// KEY
+  int64_t key;
+// RN run number of the record
+  uint64_t rn;
+// LOSER index of the node holding the loser
+  uint64_t loser;
+};
+
+// input read a buffer at a time
+struct Input {
+  int64_t* buf;
+  uint64_t next;
+  uint64_t last;
+// keys not yet read into the buffer
+  uint64_t unread;
+};
+
+// run file being written
+struct Run {
+  const char* prefix;
+  FILE* file;
+  uint64_t number;
+  uint64_t keys;
+  int64_t* buf;
+  uint64_t next;
+};
+
+// next key of the input, returns false when input is exhausted
+static bool input(struct Input* in, int64_t* key)
+{
+
+  if(in->next == in->last) {
+
+    if(in->unread == 0)
+      return false;
+
+    const uint64_t want = in->unread < BUFFER_KEYS ? in->unread : BUFFER_KEYS;
+
+    if(fread(in->buf, sizeof(*in->buf), want, stdin) != want) {
+      fprintf(stderr, "Invalid input data: input ends %" PRIu64 " keys short\n", in->unread);
+      usage();
+      exit(1);
+    }
+
+    in->unread -= want;
+    in->next = 0;
+    in->last = want;
+  }
+
+  *key = in->buf[in->next++];
+
+  return true;
+}
+
+static void flush(struct Run* run)
+{
+  if(fwrite(run->buf, sizeof(*run->buf), run->next, run->file) != run->next) {
+    fprintf(stderr, "error: write %s.%" PRIu64 ".dat failure\n", run->prefix, run->number);
+    exit(2);
+  }
+  run->next = 0;
+}
+
+// starts run file number
+static void openRun(struct Run* run, const uint64_t number)
+{
+
+  char name[strlen(run->prefix) + 32];
+  sprintf(name, "%s.%" PRIu64 ".dat", run->prefix, number);
+
+  run->file = fopen(name, "wb");
+
+  if(run->file == NULL) {
+    fprintf(stderr, "error: open %s failure\n", name);
+    exit(2);
+  }
+
+  run->number = number;
+  run->keys = 0;
+  run->next = 0;
+
+// number of keys is written when the run is complete
+  fwrite(&run->keys, sizeof run->keys, 1, run->file);
+}
+
+// completes current run file with its number of keys
+static void closeRun(struct Run* run)
+{
+
+  flush(run);
+
+  rewind(run->file);
+  fwrite(&run->keys, sizeof run->keys, 1, run->file);
+
+  if(fclose(run->file) != 0) {
+    fprintf(stderr, "error: write %s.%" PRIu64 ".dat failure\n", run->prefix, run->number);
+    exit(2);
+  }
+
+  printf("%s.%" PRIu64 ".dat %" PRIu64 "\n", run->prefix, run->number, run->keys);
+
+  run->file = NULL;
+}
+
+static void output(struct Run* run, const int64_t key)
+{
+  run->buf[run->next++] = key;
+  ++run->keys;
+  if(run->next == BUFFER_KEYS)
+    flush(run);
+}
+
+// ReplacementSelection implements Algorithm R
+// distributes the input into runs written by run
+// returns number of runs
+uint64_t ReplacementSelection(const uint64_t P, struct Node X[P], struct Input* in, struct Run* run)
+{
+
+// R1 [Initialize] RMAX <- 0, RC <- 0, LASTKEY <- infinity, Q <- LOC(X[0]), RQ <- 0
+  uint64_t rmax = 0, rc = 0, q = 0, rq = 0;
+  int64_t lastkey = 0;
+
+// R1 [Initialize] LOSER(X[j]) <- LOC(X[j]), RN(X[j]) <- 0 for 0 <= j < P
+// KEY(X[j]) <- 0 too, R6 compares keys of dummy records that tie on RN
+  for(uint64_t j = 0; j < P; ++j) {
+    X[j].loser = j;
+    X[j].rn = 0;
+    X[j].key = 0;
+  }
+
+  for(;;) {
+
+// R2 [End of run?] If RQ = RC go to R3
+    if(rq != rc) {
+// R2 [End of run?] run RC is complete
+      if(rc != 0)
+        closeRun(run);
+// R2 [End of run?] If RQ > RMAX terminate, otherwise RC <- RQ
+      if(rq > rmax)
+        break;
+      rc = rq;
+      openRun(run, rc);
+    }
+
+// R3 [Output top of tree] If RQ != 0 output RECORD(Q) and set LASTKEY <- KEY(Q)
+    if(rq != 0) {
+      output(run, X[q].key);
+      lastkey = X[q].key;
+    }
+
+// R4 [Input new record] If input is exhausted set RQ <- RMAX + 1
+    if(!input(in, &X[q].key)) {
+      rq = rmax + 1;
+    } else {
+// R4 [Input new record] If KEY(Q) < LASTKEY set RQ <- RQ + 1 and RMAX <- RQ if RQ > RMAX
+// LASTKEY is infinity while RQ = 0 since nothing has been output yet
+      if(rq == 0 || X[q].key < lastkey) {
+        ++rq;
+        if(rq > rmax)
+          rmax = rq;
+      }
+    }
+
+// R5 [Prepare to update] T <- PE(Q)
+    X[q].rn = rq;
+
+    for(uint64_t t = (P + q) / 2;; t /= 2) {
+
+// R6 [Set new loser] If RN(LOSER(T)) < RQ or RN(LOSER(T)) = RQ and KEY(LOSER(T)) < KEY(Q)
+// R6 [Set new loser] LOSER(T) <-> Q, RQ <-> RN(Q)
+      const uint64_t l = X[t].loser;
+      if(X[l].rn < X[q].rn || (X[l].rn == X[q].rn && X[l].key < X[q].key)) {
+        X[t].loser = q;
+        q = l;
+      }
+
+// R7 [Move up] If T = LOC(X[1]) go to R2, otherwise T <- PI(T) and repeat R6
+      if(t == 1)
+        break;
+    }
+
+    rq = X[q].rn;
+  }
+
+  return rmax;
+}
+
+int main(int argc, char* argv[])
+{
+
+// number of records in the tree
+  uint64_t P = P_RECORDS;
+
+// run files are prefix.1.dat, prefix.2.dat, ...
+  const char* prefix = "run";
+
+  for(int opt; (opt = getopt(argc, argv, "P:ho:")) != -1;) {
+    switch(opt) {
+      case 'P':
+        P = strtoull(optarg, NULL, 10);
+        break;
+      case 'o':
+        prefix = optarg;
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind < argc || P < 2) {
+    usage();
+    exit(1);
+  }
+
+  struct Input in = {malloc(BUFFER_KEYS * sizeof(*in.buf)), 0, 0, 0};
+  struct Run run = {prefix, NULL, 0, 0, malloc(BUFFER_KEYS * sizeof(*run.buf)), 0};
+  struct Node* X = malloc(P * sizeof(*X));
+
+  if(in.buf == NULL || run.buf == NULL || X == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+// read 64-bit size of input as binary data, keys are read as they are needed
+  if(fread(&in.unread, sizeof in.unread, 1, stdin) != 1) {
+    fprintf(stderr, "Invalid input data: no number of keys\n");
+    usage();
+    exit(1);
+  }
+
+  ReplacementSelection(P, X, &in, &run);
+
+  free(X);
+  free(run.buf);
+  free(in.buf);
+
+  return 0;
+}
@@ -0,0 +1,116 @@
+// loser_tree.c
+
+// Tree of losers for k-way merging
+// 5.4.1 Multiway Merging and Replacement Selection
+// The Art of Computer Programming, Donald Knuth
+
+#include "loser_tree.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// a k-way merge could find the smallest of k keys with k - 1 comparisons for every key output
+// a tournament finds it with about lg k comparisons by keeping the results of earlier matches
+// in a tree of winners every internal node holds the winner of the match between its two subtrees
+// when the overall winner is replaced by the next key of its source the matches on its path are replayed
+// and each replay compares against the sibling, the winner of the other subtree
+// a tree of losers stores the loser of each match instead
+// the new key then meets exactly the keys stored on its own path from leaf to root
+// which are the opponents it has to beat, and siblings need not be looked at
+
+// the tree is a complete binary tree with k leaves
+// leaf k + s stands for source s and internal node j has children 2j and 2j + 1
+// so the path from the leaf of source s goes through nodes (k + s)/2, (k + s)/4, ..., 1
+// an empty source loses to every source that is not empty, which plays the part of the key +infinity
+// without taking a value away from int64_t keys
+
+// true if source a comes out before source b
+static bool beats(const struct LoserTree* t, const uint64_t a, const uint64_t b)
+{
+  if(t->empty[a])
+    return false;
+  if(t->empty[b])
+    return true;
+  return t->key[a] < t->key[b] || (t->key[a] == t->key[b] && a < b);
+}
+
+void loser_tree_init(struct LoserTree* t, const uint64_t k)
+{
+
+  t->k = k;
+  t->node = malloc(k * sizeof(*t->node));
+  t->key = malloc(k * sizeof(*t->key));
+  t->empty = malloc(k * sizeof(*t->empty));
+
+  if(t->node == NULL || t->key == NULL || t->empty == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  for(uint64_t s = 0; s < k; ++s) {
+    t->node[s] = 0;
+    t->key[s] = 0;
+    t->empty[s] = true;
+  }
+}
+
+void loser_tree_free(struct LoserTree* t)
+{
+  free(t->empty);
+  free(t->key);
+  free(t->node);
+}
+
+void loser_tree_build(struct LoserTree* t)
+{
+
+  const uint64_t k = t->k;
+
+// winner[j] is the winner at node j, leaves are winner[k],...,winner[2k - 1]
+  uint64_t* winner = malloc(2 * k * sizeof(*winner));
+
+  if(winner == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  for(uint64_t s = 0; s < k; ++s) {
+    winner[k + s] = s;
+  }
+
+// play the matches from the bottom up
+  for(uint64_t j = k - 1; j >= 1; --j) {
+    const uint64_t a = winner[2 * j];
+    const uint64_t b = winner[2 * j + 1];
+    if(beats(t, a, b)) {
+      winner[j] = a;
+      t->node[j] = b;
+    } else {
+      winner[j] = b;
+      t->node[j] = a;
+    }
+  }
+
+  t->node[0] = winner[1];
+
+  free(winner);
+}
+
+void loser_tree_replay(struct LoserTree* t)
+{
+
+  uint64_t w = t->node[0];
+
+// the new key of w meets the loser stored at each node on its path, the winner goes on up
+  for(uint64_t j = (t->k + w) / 2; j >= 1; j /= 2) {
+    const uint64_t l = t->node[j];
+    if(beats(t, l, w)) {
+      t->node[j] = w;
+      w = l;
+    }
+  }
+
+  t->node[0] = w;
+}
@@ -0,0 +1,35 @@
+#ifndef LOSER_TREE_H
+#define LOSER_TREE_H
+
+// Tree of losers for k-way merging
+// 5.4.1 Multiway Merging and Replacement Selection
+// The Art of Computer Programming, Donald Knuth
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// tree of losers over k sources numbered 0,...,k-1, k >= 1
+// key[s] is the current key of source s, empty[s] is true when source s has no keys left
+// node[1],...,node[k-1] are internal nodes holding the source that lost the match there
+// node[0] holds the source that won the whole tournament, the one with the smallest key
+// all sources are empty when the winner is
+// equal keys go to the lower numbered source first so merging is stable
+struct LoserTree {
+  uint64_t k;
+  uint64_t* node;
+  int64_t* key;
+  bool* empty;
+};
+
+// allocates a tree for k sources with all sources empty
+void loser_tree_init(struct LoserTree* t, const uint64_t k);
+
+void loser_tree_free(struct LoserTree* t);
+
+// plays the whole tournament after key and empty of every source are set
+void loser_tree_build(struct LoserTree* t);
+
+// replays the matches on the path of the winner after its key or empty is changed
+void loser_tree_replay(struct LoserTree* t);
+
+#endif
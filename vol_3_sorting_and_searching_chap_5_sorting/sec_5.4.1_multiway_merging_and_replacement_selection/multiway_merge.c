@@ -0,0 +1,152 @@
+// multiway_merge.c
+
+// k-way merge of sorted files with a tree of losers
+// 5.4.1 Multiway Merging and Replacement Selection
+// The Art of Computer Programming, Donald Knuth
+
+#include "loser_tree.h"
+#include "../sec_5.2.4_sorting_by_merging/sorted_stream.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+// all k files are merged in one pass, repeated two-way merging would need ceiling(lg k) passes over the data
+// each file is read a buffer at a time as in algorithm_m_two_way_merge.stream of 5.2.4
+// so memory is k + 1 buffers no matter how large the files are
+// the tree of losers makes about lg k comparisons for every key output
+
+// default number of keys in each buffer, 512 KB
+#define BUFFER_KEYS (UINT64_C(1) << 16)
+
+static void usage()
+{
+  puts("usage:multiway_merge [-b keys] in_1.dat ... in_k.dat >out.dat");
+  puts("Implements k-way merging with a tree of losers, 5.4.1 Multiway Merging and Replacement Selection, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads sorted 64-bit values as binary data from k files or pipes, outputs merged 64-bit values as binary data");
+  puts("memory used is k + 1 buffers no matter how large the files are");
+
+  puts("");
+  puts("binary input data format of each file");
+  puts("uint64_t N, can be 0 for empty file");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("binary output data format");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("-b: number of keys in each buffer, default is 65536");
+
+  puts("");
+  puts("examples:");
+  puts("multiway_merge data/multiway_merge/in.1.*.le.dat | od -An -td8 -w8 -v");
+  puts("multiway_merge segment.*.dat >merged.dat");
+}
+
+// moves the next key of source s into the tree or marks s empty
+static void advance(struct LoserTree* t, struct Stream* in, const uint64_t s)
+{
+  if(stream_fill(&in[s])) {
+    t->key[s] = in[s].buf[in[s].next++];
+  } else {
+    t->empty[s] = true;
+  }
+}
+
+// merges sorted files in_0,...,in_(k-1) into z on stdout
+void merge(const uint64_t k, struct Stream in[], struct Output* z)
+{
+
+  struct LoserTree t;
+  loser_tree_init(&t, k);
+
+  for(uint64_t s = 0; s < k; ++s) {
+    t.empty[s] = false;
+    advance(&t, in, s);
+  }
+
+  loser_tree_build(&t);
+
+  for(;;) {
+
+    const uint64_t w = t.node[0];
+
+    if(t.empty[w])
+      break;
+
+    z->buf[z->next++] = t.key[w];
+
+    if(z->next == z->keys)
+      output_flush(z);
+
+    advance(&t, in, w);
+    loser_tree_replay(&t);
+  }
+
+  output_flush(z);
+
+  loser_tree_free(&t);
+}
+
+int main(int argc, char* argv[])
+{
+
+// number of keys in each buffer
+  uint64_t keys = BUFFER_KEYS;
+
+  for(int opt; (opt = getopt(argc, argv, "b:h")) != -1;) {
+    switch(opt) {
+      case 'b':
+        keys = strtoull(optarg, NULL, 10);
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(optind == argc || keys == 0) {
+    usage();
+    exit(1);
+  }
+
+  const uint64_t k = argc - optind;
+
+  struct Stream* in = malloc(k * sizeof(*in));
+  struct Output z = {malloc(keys * sizeof(*z.buf)), 0, keys};
+
+  if(in == NULL || z.buf == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  uint64_t zsize = 0;
+
+  for(uint64_t s = 0; s < k; ++s) {
+    stream_open(&in[s], argv[optind + s], keys, usage);
+    zsize += in[s].unread;
+  }
+
+// write number of values to follow
+  write_fully(&zsize, sizeof zsize);
+
+  merge(k, in, &z);
+
+  for(uint64_t s = 0; s < k; ++s) {
+    stream_close(&in[s]);
+  }
+
+  free(z.buf);
+  free(in);
+
+  return 0;
+}
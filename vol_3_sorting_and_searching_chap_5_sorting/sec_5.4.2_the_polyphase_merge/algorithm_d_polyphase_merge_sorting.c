@@ -0,0 +1,425 @@
+// algorithm_d_polyphase_merge_sorting.c
+
+// Algorithm D (Polyphase merge sorting with "horizontal" distribution)
+// 5.4.2 The Polyphase Merge
+// The Art of Computer Programming, Donald Knuth
+
+#include "../sec_5.4.1_multiway_merging_and_replacement_selection/loser_tree.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+// sorted runs from files named on the command line, such as those written by algorithm_r_replacement_selection,
+// are spread over T - 1 temporary files that play the part of tapes, in the counts of a perfect Fibonacci distribution
+// D[j] dummy runs make up the difference when the number of runs is not perfect
+// each phase then merges runs from the P = T - 1 input tapes onto the one output tape
+// till the input tape with fewest runs is empty, and that tape becomes the output of the next phase
+// only T files are open at any time no matter how many runs there are
+
+// a merge of one run from each tape with D[j] = 0 uses a tree of losers from 5.4.1
+// tapes with dummy runs are empty sources of the tree
+
+// each tape holds a sequence of runs, each run stored as uint64_t n followed by n keys like the files of this chapter
+// the length of a merged run is the sum of the lengths of its inputs and is written before its keys
+
+// passes over the data is the number of keys read by merge phases divided by N as in Knuth's tables
+// the initial distribution is not counted
+
+// default number of keys in the buffer of each tape
+#define BUFFER_KEYS (UINT64_C(1) << 16)
+
+// most tapes, every tape is an open temporary file with a buffer and the arrays of Algorithm D are on the stack
+#define TAPES_MAX 256
+
+static void usage()
+{
+  puts("usage:algorithm_d_polyphase_merge_sorting [-T tapes] [-b keys] run_1.dat ... run_S.dat >out.dat");
+  puts("Implements Algorithm D (Polyphase merge sorting with \"horizontal\" distribution), 5.4.2 The Polyphase Merge, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads S sorted runs of 64-bit values as binary data from files, outputs merged 64-bit values as binary data");
+  puts("prints number of runs, phases and passes over the data to stderr");
+
+  puts("");
+  puts("binary input data format of each run file");
+  puts("uint64_t N, can be 0 for empty run");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("binary output data format");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("-T: number of tapes, temporary files open at one time, from 3 to 256, default is 6");
+  puts("-b: number of keys in the buffer of each tape, default is 65536");
+
+  puts("");
+  puts("examples:");
+  puts("algorithm_d_polyphase_merge_sorting -T 3 data/algorithm_d_polyphase_merge_sorting/in.1.*.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_r_replacement_selection -o /tmp/run <big.dat && algorithm_d_polyphase_merge_sorting /tmp/run.*.dat >sorted.dat");
+}
+
+// temporary file used as a tape
+struct Tape {
+  FILE* file;
+// real runs on the tape not yet read
+  uint64_t runs;
+// keys of the run being read not yet in the buffer
+  uint64_t left;
+// buffer holds keys buf[next],...,buf[last - 1]
+  int64_t* buf;
+  uint64_t next;
+  uint64_t last;
+  uint64_t keys;
+};
+
+static void readFully(FILE* file, void* data, const uint64_t size, const uint64_t count, const char* name)
+{
+  if(fread(data, size, count, file) != count) {
+    fprintf(stderr, "Invalid input data: %s ends early\n", name);
+    usage();
+    exit(1);
+  }
+}
+
+static void writeFully(FILE* file, const void* data, const uint64_t size, const uint64_t count)
+{
+  if(fwrite(data, size, count, file) != count) {
+    fprintf(stderr, "error: write failure\n");
+    exit(2);
+  }
+}
+
+// starts reading the next run of tape, returns its number of keys
+static uint64_t startRun(struct Tape* tape)
+{
+  readFully(tape->file, &tape->left, sizeof tape->left, 1, "tape");
+  tape->next = tape->last = 0;
+  --tape->runs;
+  return tape->left;
+}
+
+// next key of the run being read, returns false at end of run
+static bool nextKey(struct Tape* tape, int64_t* key)
+{
+
+  if(tape->next == tape->last) {
+
+    if(tape->left == 0)
+      return false;
+
+    const uint64_t want = tape->left < tape->keys ? tape->left : tape->keys;
+    readFully(tape->file, tape->buf, sizeof(*tape->buf), want, "tape");
+
+    tape->left -= want;
+    tape->next = 0;
+    tape->last = want;
+  }
+
+  *key = tape->buf[tape->next++];
+
+  return true;
+}
+
+// output buffer of the tape being written
+struct Output {
+  FILE* file;
+  int64_t* buf;
+  uint64_t next;
+  uint64_t keys;
+};
+
+static void put(struct Output* out, const int64_t key)
+{
+  out->buf[out->next++] = key;
+  if(out->next == out->keys) {
+    writeFully(out->file, out->buf, sizeof(*out->buf), out->next);
+    out->next = 0;
+  }
+}
+
+static void flush(struct Output* out)
+{
+  writeFully(out->file, out->buf, sizeof(*out->buf), out->next);
+  out->next = 0;
+}
+
+// D2 writes the run in file name on tape, returns its number of keys
+static uint64_t copyRun(const char* name, struct Tape* tape, struct Output* out)
+{
+
+  FILE* in = fopen(name, "rb");
+
+  if(in == NULL) {
+    fprintf(stderr, "error: open %s failure\n", name);
+    exit(2);
+  }
+
+  uint64_t n;
+  readFully(in, &n, sizeof n, 1, name);
+
+  out->file = tape->file;
+  writeFully(out->file, &n, sizeof n, 1);
+
+  for(uint64_t left = n; left > 0;) {
+    const uint64_t want = left < out->keys ? left : out->keys;
+    readFully(in, out->buf, sizeof(*out->buf), want, name);
+    writeFully(out->file, out->buf, sizeof(*out->buf), want);
+    left -= want;
+  }
+
+  fclose(in);
+
+  ++tape->runs;
+
+  return n;
+}
+
+// merges one run from each of the k tapes in source onto out
+// returns number of keys merged
+static uint64_t mergeRuns(const uint64_t k, struct Tape* source[k], struct LoserTree* tree, struct Output* out)
+{
+
+  uint64_t n = 0;
+  for(uint64_t s = 0; s < k; ++s) {
+    n += startRun(source[s]);
+  }
+
+// merged run is as long as all its inputs
+  writeFully(out->file, &n, sizeof n, 1);
+
+  tree->k = k;
+  for(uint64_t s = 0; s < k; ++s) {
+    tree->empty[s] = !nextKey(source[s], &tree->key[s]);
+  }
+
+  loser_tree_build(tree);
+
+  for(;;) {
+
+    const uint64_t w = tree->node[0];
+
+    if(tree->empty[w])
+      break;
+
+    put(out, tree->key[w]);
+
+    tree->empty[w] = !nextKey(source[w], &tree->key[w]);
+    loser_tree_replay(tree);
+  }
+
+  flush(out);
+
+  return n;
+}
+
+int main(int argc, char* argv[])
+{
+
+// number of tapes
+  uint64_t T = 6;
+
+// number of keys in each buffer
+  uint64_t keys = BUFFER_KEYS;
+
+  for(int opt; (opt = getopt(argc, argv, "T:b:h")) != -1;) {
+    switch(opt) {
+      case 'T':
+        T = strtoull(optarg, NULL, 10);
+        break;
+      case 'b':
+        keys = strtoull(optarg, NULL, 10);
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+  if(keys == 0) {
+    usage();
+    exit(1);
+  }
+
+  if(T < 3 || T > TAPES_MAX) {
+    fprintf(stderr, "Invalid input data: number of tapes T must be from 3 to %d\n", TAPES_MAX);
+    usage();
+    exit(1);
+  }
+
+// number of runs
+  const uint64_t S = argc - optind;
+  char** const run = &argv[optind];
+
+  if(S == 0) {
+    const uint64_t zsize = 0;
+    writeFully(stdout, &zsize, sizeof zsize, 1);
+    fprintf(stderr, "runs 0, tapes %" PRIu64 ", phases 0, passes 0.00\n", T);
+    return 0;
+  }
+
+  const uint64_t P = T - 1;
+
+// arrays are indexed from 1 as in Algorithm D
+  uint64_t A[T + 1], D[T + 1], TAPE[T + 1];
+  struct Tape tape[T + 1];
+
+  for(uint64_t j = 1; j <= T; ++j) {
+    tape[j] = (struct Tape){tmpfile(), 0, 0, malloc(keys * sizeof(*tape[j].buf)), 0, 0, keys};
+    if(tape[j].file == NULL) {
+      fprintf(stderr, "error: tmpfile failure\n");
+      exit(2);
+    }
+    if(tape[j].buf == NULL) {
+      fprintf(stderr, "error: malloc failure\n");
+      exit(2);
+    }
+  }
+
+  struct Output out = {NULL, malloc(keys * sizeof(*out.buf)), 0, keys};
+  struct Tape* source[P];
+  struct LoserTree tree;
+  loser_tree_init(&tree, P);
+
+  if(out.buf == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+// D1 [Initialize] A[j] <- D[j] <- 1, TAPE[j] <- j for 1 <= j < T, A[T] <- D[T] <- 0, TAPE[T] <- T
+  for(uint64_t j = 1; j < T; ++j) {
+    A[j] = D[j] = 1;
+    TAPE[j] = j;
+  }
+  A[T] = D[T] = 0;
+  TAPE[T] = T;
+// D1 [Initialize] l <- 1, j <- 1
+  uint64_t l = 1, j = 1;
+
+// number of keys
+  uint64_t N = 0;
+
+  for(uint64_t r = 0;;) {
+
+// D2 [Input to tape j] Write one run on tape j and decrease D[j] by 1
+    N += copyRun(run[r++], &tape[j], &out);
+    --D[j];
+
+// D2 [Input to tape j] If input is exhausted, rewind all tapes and go to D5
+    if(r == S)
+      break;
+
+// D3 [Advance j] If D[j] < D[j + 1], increase j by 1 and return to D2
+    if(D[j] < D[j + 1]) {
+      ++j;
+      continue;
+    }
+// D3 [Advance j] If D[j] = 0 go to D4, otherwise set j <- 1 and return to D2
+    if(D[j] != 0) {
+      j = 1;
+      continue;
+    }
+
+// D4 [Up a level] l <- l + 1, a <- A[1]
+    ++l;
+    const uint64_t a = A[1];
+// D4 [Up a level] D[j] <- a + A[j + 1] - A[j], A[j] <- a + A[j + 1] for j = 1,...,P
+    for(j = 1; j <= P; ++j) {
+      D[j] = a + A[j + 1] - A[j];
+      A[j] = a + A[j + 1];
+    }
+// D4 [Up a level] j <- 1 and return to D2
+    j = 1;
+  }
+
+  for(uint64_t t = 1; t <= T; ++t) {
+    rewind(tape[t].file);
+  }
+
+// keys read by merge phases
+  uint64_t merged = 0;
+  uint64_t phases = 0;
+
+  for(;;) {
+
+// D5 [Merge] If l = 0, sorting is complete and the output is on TAPE[1]
+    if(l == 0)
+      break;
+
+// D5 [Merge] Merge runs from TAPE[1],...,TAPE[P] onto TAPE[T] till TAPE[P] is empty and D[P] = 0
+    out.file = tape[TAPE[T]].file;
+
+    while(tape[TAPE[P]].runs > 0 || D[P] > 0) {
+
+      uint64_t k = 0;
+      for(j = 1; j <= P; ++j) {
+        if(D[j] == 0)
+          source[k++] = &tape[TAPE[j]];
+      }
+
+      if(k == 0) {
+// D5 [Merge] If D[j] > 0 for all j, decrease each D[j] by 1 and increase D[T] by 1
+        for(j = 1; j <= P; ++j) {
+          --D[j];
+        }
+        ++D[T];
+      } else {
+// D5 [Merge] Otherwise merge one run from each TAPE[j] with D[j] = 0 and decrease D[j] by 1 for every other j
+        for(j = 1; j <= P; ++j) {
+          if(D[j] > 0)
+            --D[j];
+        }
+        merged += mergeRuns(k, source, &tree, &out);
+        ++tape[TAPE[T]].runs;
+      }
+    }
+
+    ++phases;
+
+// D6 [Down a level] l <- l - 1, rewind TAPE[P] and TAPE[T]
+    --l;
+    rewind(tape[TAPE[P]].file);
+    rewind(tape[TAPE[T]].file);
+
+// D6 [Down a level] (TAPE[1],...,TAPE[T]) <- (TAPE[T], TAPE[1],...,TAPE[T - 1]), (D[1],...,D[T]) <- (D[T], D[1],...,D[T - 1])
+    const uint64_t tapeT = TAPE[T], dT = D[T];
+    for(j = T; j > 1; --j) {
+      TAPE[j] = TAPE[j - 1];
+      D[j] = D[j - 1];
+    }
+    TAPE[1] = tapeT;
+    D[1] = dT;
+  }
+
+// the one run on TAPE[1] is the sorted output
+  struct Tape* result = &tape[TAPE[1]];
+
+  const uint64_t zsize = startRun(result);
+  writeFully(stdout, &zsize, sizeof zsize, 1);
+
+  out.file = stdout;
+  for(int64_t key; nextKey(result, &key);) {
+    put(&out, key);
+  }
+  flush(&out);
+
+  fprintf(stderr, "runs %" PRIu64 ", tapes %" PRIu64 ", phases %" PRIu64 ", passes %.2f\n", S, T, phases, N == 0 ? 0.0 : (double)merged / N);
+
+  tree.k = P;
+  loser_tree_free(&tree);
+  free(out.buf);
+  for(uint64_t t = 1; t <= T; ++t) {
+    free(tape[t].buf);
+    fclose(tape[t].file);
+  }
+
+  return 0;
+}
@@ -0,0 +1,740 @@
+// algorithm_f_forecasting_with_floating_buffers.c
+
+// Algorithm F (Forecasting with floating buffers)
+// 5.4.6 Practical Considerations for Tape Merging
+// The Art of Computer Programming, Donald Knuth
+
+#include "../sec_5.4.1_multiway_merging_and_replacement_selection/loser_tree.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <threads.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define FORECAST_IO_URING
+#endif
+
+// P sorted files are merged with 2P input buffers of B keys and 2 output buffers
+// a merge that gives each file two fixed buffers waits whenever both buffers of one file are empty
+// here the P + 1 input buffers not being merged from float between files
+// the file whose buffer will run out first is the one whose last key read so far is smallest
+// since every key of the other files up to their last key read comes out before it
+// so the next block read is always the next block of that file, forecast from keys already in memory
+// reads go on while keys are merged, and with 2P buffers the merge never waits for a block
+// it has not already asked for, as Knuth shows for tapes
+
+// the steps of Algorithm F are
+// F1 [Initialize] read the first block of each file, the other buffers are free, forecast the first read
+// F2 [Merge] merge from the head buffers into the output buffer till it is full or a head buffer is empty
+// F3 [Output] start writing the full output buffer and switch to the other one
+// F4 [Wait for input] a file whose head buffer is empty waits for the block forecast for it
+// F5 [Input complete] the block just read goes at the end of the buffers of its file, LASTKEY of the file is its last key
+// F6 [Forecast] start reading the next block of the file with the smallest LASTKEY into a free buffer
+
+// one read and one write are in flight at a time, as with one disk arm
+// output goes through 2 buffers so one is written while the other fills
+// reads and writes are submitted to io_uring when the kernel has it
+// otherwise each of them is done by a thread with pread and write
+
+// default number of keys in a block, 256 KB
+#define BLOCK_KEYS (UINT64_C(1) << 15)
+
+// tags of the two requests that can be in flight
+#define READ 0
+#define WRITE 1
+
+static void usage()
+{
+  puts("usage:algorithm_f_forecasting_with_floating_buffers [-b keys] [-t] [-v] in_1.dat ... in_P.dat >out.dat");
+  puts("Implements Algorithm F (Forecasting with floating buffers), 5.4.6 Practical Considerations for Tape Merging, The Art of Computer Programming Volume 3, Sorting and Searching by Donald Knuth");
+
+  puts("reads sorted 64-bit values as binary data from P files, outputs merged 64-bit values as binary data");
+  puts("input blocks are read ahead into 2P floating buffers while keys are merged");
+
+  puts("");
+  puts("binary input data format of each file");
+  puts("uint64_t N, can be 0 for empty file");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("binary output data format");
+  puts("uint64_t N");
+  puts("int64_t[N] sorted data");
+
+  puts("");
+  puts("-b: number of keys in a block, default is 32768");
+  puts("-t: read and write with threads even if io_uring is available");
+  puts("-v: print I/O method, blocks read and waits for blocks to stderr");
+
+  puts("");
+  puts("examples:");
+  puts("algorithm_f_forecasting_with_floating_buffers data/algorithm_f_forecasting_with_floating_buffers/in.1.*.le.dat | od -An -td8 -w8 -v");
+  puts("algorithm_f_forecasting_with_floating_buffers -v /tmp/run.*.dat >sorted.dat");
+}
+
+// read or write of size bytes at offset, offset -1 writes at the current position
+struct Request {
+  int fd;
+  char* data;
+  uint64_t size;
+  int64_t offset;
+  bool write;
+};
+
+// does the rest of a request that has done bytes already
+static void transfer(const struct Request* r, uint64_t done)
+{
+
+  while(done < r->size) {
+
+    ssize_t n;
+    if(r->write) {
+      n = r->offset < 0 ? write(r->fd, r->data + done, r->size - done) : pwrite(r->fd, r->data + done, r->size - done, r->offset + done);
+    } else {
+      n = pread(r->fd, r->data + done, r->size - done, r->offset + done);
+    }
+
+    if(n < 0 && errno == EINTR)
+      continue;
+
+    if(n <= 0) {
+      fprintf(stderr, "error: %s: %s\n", r->write ? "write" : "read", n < 0 ? strerror(errno) : "file ends early");
+      exit(2);
+    }
+
+    done += n;
+  }
+}
+
+struct Io {
+// true for io_uring, false for threads
+  bool uring;
+// requests in flight by tag
+  struct Request slot[2];
+  bool busy[2];
+
+#ifdef FORECAST_IO_URING
+  int ring;
+  unsigned* sqHead;
+  unsigned* sqTail;
+  unsigned sqMask;
+  unsigned* sqArray;
+  struct io_uring_sqe* sqes;
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned cqMask;
+  struct io_uring_cqe* cqes;
+#endif
+
+// one thread for each tag
+  thrd_t worker[2];
+  mtx_t lock;
+  cnd_t cond;
+  bool queued[2];
+  bool done[2];
+  bool quit;
+};
+
+#ifdef FORECAST_IO_URING
+
+// sets up a ring with room for both requests, returns false if io_uring cannot be used
+static bool uringInit(struct Io* io)
+{
+
+  struct io_uring_params p;
+  memset(&p, 0, sizeof p);
+
+  io->ring = syscall(__NR_io_uring_setup, 2, &p);
+
+  if(io->ring < 0)
+    return false;
+
+// IORING_OP_READ and IORING_OP_WRITE came with writes at the current position
+  if(!(p.features & IORING_FEAT_RW_CUR_POS)) {
+    close(io->ring);
+    return false;
+  }
+
+  char* sq = mmap(NULL, p.sq_off.array + p.sq_entries * sizeof(unsigned), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ring, IORING_OFF_SQ_RING);
+  char* cq = mmap(NULL, p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ring, IORING_OFF_CQ_RING);
+  io->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ring, IORING_OFF_SQES);
+
+  if(sq == MAP_FAILED || cq == MAP_FAILED || io->sqes == MAP_FAILED) {
+    close(io->ring);
+    return false;
+  }
+
+  io->sqHead = (unsigned*)(sq + p.sq_off.head);
+  io->sqTail = (unsigned*)(sq + p.sq_off.tail);
+  io->sqMask = *(unsigned*)(sq + p.sq_off.ring_mask);
+  io->sqArray = (unsigned*)(sq + p.sq_off.array);
+  io->cqHead = (unsigned*)(cq + p.cq_off.head);
+  io->cqTail = (unsigned*)(cq + p.cq_off.tail);
+  io->cqMask = *(unsigned*)(cq + p.cq_off.ring_mask);
+  io->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+  return true;
+}
+
+static void uringSubmit(struct Io* io, const uint64_t tag)
+{
+
+  const struct Request* r = &io->slot[tag];
+
+  const unsigned tail = *io->sqTail;
+  const unsigned index = tail & io->sqMask;
+
+  struct io_uring_sqe* sqe = &io->sqes[index];
+  memset(sqe, 0, sizeof *sqe);
+  sqe->opcode = r->write ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe->fd = r->fd;
+  sqe->addr = (uint64_t)(uintptr_t)r->data;
+  sqe->len = r->size;
+  sqe->off = r->offset;
+  sqe->user_data = tag;
+
+  io->sqArray[index] = index;
+  __atomic_store_n(io->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+  while(syscall(__NR_io_uring_enter, io->ring, 1, 0, 0, NULL, 0) < 0) {
+    if(errno != EINTR) {
+      fprintf(stderr, "error: io_uring_enter: %s\n", strerror(errno));
+      exit(2);
+    }
+  }
+}
+
+static uint64_t uringWait(struct Io* io)
+{
+
+  unsigned head = *io->cqHead;
+
+  while(head == __atomic_load_n(io->cqTail, __ATOMIC_ACQUIRE)) {
+    if(syscall(__NR_io_uring_enter, io->ring, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+      fprintf(stderr, "error: io_uring_enter: %s\n", strerror(errno));
+      exit(2);
+    }
+  }
+
+  const struct io_uring_cqe* cqe = &io->cqes[head & io->cqMask];
+  const uint64_t tag = cqe->user_data;
+  const int32_t res = cqe->res;
+
+  __atomic_store_n(io->cqHead, head + 1, __ATOMIC_RELEASE);
+
+  if(res < 0) {
+    fprintf(stderr, "error: %s: %s\n", tag == WRITE ? "write" : "read", strerror(-res));
+    exit(2);
+  }
+
+// a short transfer, such as a write to a pipe, is finished here
+  transfer(&io->slot[tag], res);
+
+  return tag;
+}
+
+#endif
+
+// thread for requests of tag, does them one at a time
+static int serve(struct Io* io, const uint64_t tag)
+{
+
+  mtx_lock(&io->lock);
+
+  for(;;) {
+
+    while(!io->queued[tag] && !io->quit) {
+      cnd_wait(&io->cond, &io->lock);
+    }
+
+    if(!io->queued[tag])
+      break;
+
+    io->queued[tag] = false;
+
+    mtx_unlock(&io->lock);
+    transfer(&io->slot[tag], 0);
+    mtx_lock(&io->lock);
+
+    io->done[tag] = true;
+    cnd_broadcast(&io->cond);
+  }
+
+  mtx_unlock(&io->lock);
+
+  return 0;
+}
+
+static int readWorker(void* arg)
+{
+  return serve(arg, READ);
+}
+
+static int writeWorker(void* arg)
+{
+  return serve(arg, WRITE);
+}
+
+static void ioInit(struct Io* io, const bool threads)
+{
+
+  io->busy[READ] = io->busy[WRITE] = false;
+
+#ifdef FORECAST_IO_URING
+  io->uring = !threads && uringInit(io);
+#else
+  (void)threads;
+  io->uring = false;
+#endif
+
+  if(io->uring)
+    return;
+
+  io->queued[READ] = io->queued[WRITE] = false;
+  io->done[READ] = io->done[WRITE] = false;
+  io->quit = false;
+
+  if(mtx_init(&io->lock, mtx_plain) != thrd_success || cnd_init(&io->cond) != thrd_success) {
+    fprintf(stderr, "error: mtx_init failure\n");
+    exit(2);
+  }
+
+  if(thrd_create(&io->worker[READ], readWorker, io) != thrd_success || thrd_create(&io->worker[WRITE], writeWorker, io) != thrd_success) {
+    fprintf(stderr, "error: thrd_create failure\n");
+    exit(2);
+  }
+}
+
+static void ioFree(struct Io* io)
+{
+
+#ifdef FORECAST_IO_URING
+  if(io->uring) {
+    close(io->ring);
+    return;
+  }
+#endif
+
+  mtx_lock(&io->lock);
+  io->quit = true;
+  cnd_broadcast(&io->cond);
+  mtx_unlock(&io->lock);
+
+  thrd_join(io->worker[READ], NULL);
+  thrd_join(io->worker[WRITE], NULL);
+
+  cnd_destroy(&io->cond);
+  mtx_destroy(&io->lock);
+}
+
+// starts request of tag, which must not be in flight
+static void ioSubmit(struct Io* io, const uint64_t tag, const int fd, void* data, const uint64_t size, const int64_t offset)
+{
+
+  io->slot[tag] = (struct Request){fd, data, size, offset, tag == WRITE};
+  io->busy[tag] = true;
+
+#ifdef FORECAST_IO_URING
+  if(io->uring) {
+    uringSubmit(io, tag);
+    return;
+  }
+#endif
+
+  mtx_lock(&io->lock);
+  io->queued[tag] = true;
+  cnd_broadcast(&io->cond);
+  mtx_unlock(&io->lock);
+}
+
+// waits for a request in flight to complete, returns its tag
+static uint64_t ioWait(struct Io* io)
+{
+
+  uint64_t tag;
+
+#ifdef FORECAST_IO_URING
+  if(io->uring) {
+    tag = uringWait(io);
+    io->busy[tag] = false;
+    return tag;
+  }
+#endif
+
+  mtx_lock(&io->lock);
+
+  while(!io->done[READ] && !io->done[WRITE]) {
+    cnd_wait(&io->cond, &io->lock);
+  }
+
+  tag = io->done[READ] ? READ : WRITE;
+  io->done[tag] = false;
+
+  mtx_unlock(&io->lock);
+
+  io->busy[tag] = false;
+
+  return tag;
+}
+
+// input buffer holding keys[next],...,keys[n - 1] of a block not yet merged
+struct Buffer {
+  int64_t* keys;
+  uint64_t n;
+  uint64_t next;
+// next buffer of the same file, or next free buffer
+  struct Buffer* link;
+};
+
+// input file
+struct File {
+  const char* name;
+  int fd;
+// keys not yet asked for and offset of the first of them
+  uint64_t unread;
+  int64_t offset;
+// buffers read and not yet merged, head is being merged
+  struct Buffer* head;
+  struct Buffer* tail;
+// last key read so far
+  int64_t last;
+};
+
+struct Merge {
+  uint64_t P;
+  uint64_t B;
+  struct File* file;
+// free input buffers
+  struct Buffer* free;
+  struct Io io;
+// file and buffer of the read in flight
+  uint64_t reading;
+  struct Buffer* pending;
+// output buffers, out[current] is being filled with outNext keys
+  int64_t* out[2];
+  uint64_t current;
+  uint64_t outNext;
+// blocks read and times the merge waited for a block
+  uint64_t reads;
+  uint64_t waits;
+};
+
+// starts reading the next block of file r into a free buffer
+static void readBlock(struct Merge* m, const uint64_t r)
+{
+
+// F6 [Forecast] take a buffer from the free buffers for the next block of file r
+
+  struct File* f = &m->file[r];
+  struct Buffer* b = m->free;
+  m->free = b->link;
+
+  b->n = f->unread < m->B ? f->unread : m->B;
+  b->next = 0;
+  b->link = NULL;
+
+  ioSubmit(&m->io, READ, f->fd, b->keys, b->n * sizeof(*b->keys), f->offset);
+
+  f->unread -= b->n;
+  f->offset += b->n * sizeof(*b->keys);
+
+  m->reading = r;
+  m->pending = b;
+  ++m->reads;
+}
+
+// starts reading the next block of the file with the smallest last key
+// if no read is in flight and a buffer is free
+static void forecast(struct Merge* m)
+{
+
+// F6 [Forecast] waits till the read in flight is complete and a buffer is free
+  if(m->io.busy[READ] || m->free == NULL)
+    return;
+
+// F6 [Forecast] find r with LASTKEY(r) smallest among files with blocks left
+// ties go to a file with no buffers left so it is not kept waiting
+  uint64_t r = m->P;
+  for(uint64_t j = 0; j < m->P; ++j) {
+    const struct File* f = &m->file[j];
+    if(f->unread == 0)
+      continue;
+    if(r == m->P || f->last < m->file[r].last || (f->last == m->file[r].last && f->head == NULL && m->file[r].head != NULL))
+      r = j;
+  }
+
+  if(r < m->P)
+    readBlock(m, r);
+}
+
+// block just read goes at the end of its file's buffers
+static void arrive(struct Merge* m)
+{
+
+// F5 [Input complete] link the buffer after the buffers of its file and set LASTKEY
+
+  struct File* f = &m->file[m->reading];
+  struct Buffer* b = m->pending;
+
+  if(f->head == NULL) {
+    f->head = b;
+  } else {
+    f->tail->link = b;
+  }
+  f->tail = b;
+  f->last = b->keys[b->n - 1];
+
+  m->pending = NULL;
+}
+
+// handles the completion of a read or write and starts the next read
+static void complete(struct Merge* m, const uint64_t tag)
+{
+
+// F5 [Input complete]
+  if(tag == READ)
+    arrive(m);
+
+// F6 [Forecast] a read can start now that the previous one is complete
+  forecast(m);
+}
+
+// moves to the next key of file r, returns false when the file has no keys left
+static bool advance(struct Merge* m, const uint64_t r, int64_t* key)
+{
+
+  struct File* f = &m->file[r];
+  struct Buffer* b = f->head;
+
+  if(++b->next < b->n) {
+    *key = b->keys[b->next];
+    return true;
+  }
+
+// F2 [Merge] head buffer of file r is empty and floats back to the free buffers
+  f->head = b->link;
+  if(f->head == NULL)
+    f->tail = NULL;
+  b->link = m->free;
+  m->free = b;
+
+// F6 [Forecast] the free buffer may let the next read start
+  forecast(m);
+
+// F4 [Wait for input] file r has no buffer left and waits for its next block
+  if(f->head == NULL && (f->unread > 0 || (m->io.busy[READ] && m->reading == r)))
+    ++m->waits;
+
+  while(f->head == NULL) {
+
+    if(f->unread == 0 && !(m->io.busy[READ] && m->reading == r))
+      return false;
+
+    if(!m->io.busy[READ] && !m->io.busy[WRITE]) {
+      fprintf(stderr, "error: no buffer free for %s\n", f->name);
+      exit(2);
+    }
+
+    complete(m, ioWait(&m->io));
+  }
+
+  *key = f->head->keys[f->head->next];
+
+  return true;
+}
+
+// writes out[current] and switches to the other output buffer
+static void writeOut(struct Merge* m)
+{
+
+// F3 [Output] wait for the previous write, start this one and switch output buffers
+
+  while(m->io.busy[WRITE]) {
+    complete(m, ioWait(&m->io));
+  }
+
+  ioSubmit(&m->io, WRITE, STDOUT_FILENO, m->out[m->current], m->outNext * sizeof(*m->out[0]), -1);
+
+  m->current ^= 1;
+  m->outNext = 0;
+}
+
+// merges the P files onto stdout
+void merge(struct Merge* m)
+{
+
+  const uint64_t P = m->P;
+
+  struct LoserTree t;
+  loser_tree_init(&t, P);
+
+// F1 [Initialize] read the first block of each file, the other P buffers stay free
+  for(uint64_t j = 0; j < P; ++j) {
+
+    if(m->file[j].unread == 0)
+      continue;
+
+    readBlock(m, j);
+    while(ioWait(&m->io) != READ);
+    arrive(m);
+  }
+
+  for(uint64_t j = 0; j < P; ++j) {
+    t.empty[j] = m->file[j].head == NULL;
+    if(!t.empty[j])
+      t.key[j] = m->file[j].head->keys[0];
+  }
+
+  loser_tree_build(&t);
+
+// F1 [Initialize] start reading the block forecast to be needed first
+  forecast(m);
+
+  for(;;) {
+
+    const uint64_t w = t.node[0];
+
+    if(t.empty[w])
+      break;
+
+// F2 [Merge] output the smallest key
+    m->out[m->current][m->outNext++] = t.key[w];
+
+// F2 [Merge] to F3 when the output buffer is full
+    if(m->outNext == m->B)
+      writeOut(m);
+
+// F2 [Merge] buffer of file w may run out and float back, to F4 to wait for the block forecast for w if needed
+    t.empty[w] = !advance(m, w, &t.key[w]);
+    loser_tree_replay(&t);
+  }
+
+// F3 [Output] the last output buffer is written when all files are used up
+  if(m->outNext > 0)
+    writeOut(m);
+
+  while(m->io.busy[READ] || m->io.busy[WRITE]) {
+    complete(m, ioWait(&m->io));
+  }
+
+  loser_tree_free(&t);
+}
+
+int main(int argc, char* argv[])
+{
+
+// number of keys in a block
+  uint64_t B = BLOCK_KEYS;
+
+// use threads for I/O
+  bool threads = false;
+
+// print I/O statistics
+  bool verbose = false;
+
+  for(int opt; (opt = getopt(argc, argv, "b:htv")) != -1;) {
+    switch(opt) {
+      case 'b':
+        B = strtoull(optarg, NULL, 10);
+        break;
+      case 't':
+        threads = true;
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      case 'h':
+        usage();
+        exit(0);
+      default:
+        usage();
+        exit(1);
+    }
+  }
+
+// a block is read with one request of at most 4 GB
+  if(optind == argc || B == 0 || B > UINT32_MAX / sizeof(int64_t)) {
+    usage();
+    exit(1);
+  }
+
+  struct Merge m = {0};
+  m.P = argc - optind;
+  m.B = B;
+  m.file = malloc(m.P * sizeof(*m.file));
+
+// 2P input buffers
+  struct Buffer* buffer = malloc(2 * m.P * sizeof(*buffer));
+  int64_t* space = malloc((2 * m.P + 2) * B * sizeof(*space));
+
+  if(m.file == NULL || buffer == NULL || space == NULL) {
+    fprintf(stderr, "error: malloc failure\n");
+    exit(2);
+  }
+
+  for(uint64_t j = 0; j < 2 * m.P; ++j) {
+    buffer[j].keys = &space[j * B];
+    buffer[j].link = m.free;
+    m.free = &buffer[j];
+  }
+
+  m.out[0] = &space[2 * m.P * B];
+  m.out[1] = &space[(2 * m.P + 1) * B];
+
+  uint64_t zsize = 0;
+
+  for(uint64_t j = 0; j < m.P; ++j) {
+
+    struct File* f = &m.file[j];
+    f->name = argv[optind + j];
+    f->fd = open(f->name, O_RDONLY);
+
+    if(f->fd < 0) {
+      fprintf(stderr, "error: open %s: %s\n", f->name, strerror(errno));
+      exit(2);
+    }
+
+    if(pread(f->fd, &f->unread, sizeof f->unread, 0) != sizeof f->unread) {
+      fprintf(stderr, "Invalid input data: %s has no number of keys\n", f->name);
+      usage();
+      exit(1);
+    }
+
+    f->offset = sizeof f->unread;
+    f->head = f->tail = NULL;
+    zsize += f->unread;
+  }
+
+// write number of values to follow
+  transfer(&(struct Request){STDOUT_FILENO, (char*)&zsize, sizeof zsize, -1, true}, 0);
+
+  ioInit(&m.io, threads);
+
+  merge(&m);
+
+  ioFree(&m.io);
+
+  if(verbose) {
+    fprintf(stderr, "%s, %" PRIu64 " files, %" PRIu64 " blocks read, %" PRIu64 " waits for a block\n", m.io.uring ? "io_uring" : "threads", m.P, m.reads, m.waits);
+  }
+
+  for(uint64_t j = 0; j < m.P; ++j) {
+    close(m.file[j].fd);
+  }
+
+  free(space);
+  free(buffer);
+  free(m.file);
+
+  return 0;
+}